@@ -0,0 +1,269 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include "ansi_screen.h"
+#include "errcode.h"
+
+#define ENTER_SCREEN "\x1b[?1049h\x1b[?25l\x1b[0m\x1b[2J"
+#define LEAVE_SCREEN "\x1b[0m\x1b[?25h\x1b[?1049l"
+#define CLEAR_SCREEN "\x1b[0m\x1b[2J"
+#define REVERSE_ON "\x1b[7m"
+//Resets every attribute, which is shorter than turning reverse video off on its own
+#define REVERSE_OFF "\x1b[m"
+//Longest escape sequence that moves the cursor, eg "\x1b[65535;65535H"
+#define MAX_MOVE_LENGTH 16
+//A front buffer cell that never matches anything, so the next flush redraws it
+#define STALE_CELL 0xFFFF
+
+int write_all(int fd, const char* data, size_t len);
+void mark_screen_stale(ansi_screen* screen);
+size_t output_capacity(ansi_screen* screen);
+unsigned int rewrite_cost(uint16_t* row, unsigned int from, unsigned int to, bool reverse);
+unsigned int decimal_length(unsigned int value);
+int read_key_byte(ansi_screen* screen);
+
+int write_all(int fd, const char* data, size_t len){
+    while(len > 0){
+        ssize_t written = write(fd, data, len);
+        if(written < 0){
+            if(errno == EINTR)
+                continue;
+            return EXIT_ERR;
+        }
+        data += written;
+        len -= written;
+    }
+    return NO_ERR;
+}
+
+//Enough for every cell of the screen to need a cursor move, an attribute change and its character
+size_t output_capacity(ansi_screen* screen){
+    size_t cells = (size_t) screen->cols * screen->rows;
+    return cells * (MAX_MOVE_LENGTH + sizeof(REVERSE_OFF) + 1) + sizeof(CLEAR_SCREEN);
+}
+
+//Bytes it takes to write cells from up to to again, starting with the given attribute
+unsigned int rewrite_cost(uint16_t* row, unsigned int from, unsigned int to, bool reverse){
+    unsigned int cost = 0;
+    for(unsigned int i = from; i < to; ++i){
+        bool cell_reverse = row[i] & ANSI_REVERSE;
+        if(cell_reverse != reverse){
+            cost += cell_reverse ? strlen(REVERSE_ON) : strlen(REVERSE_OFF);
+            reverse = cell_reverse;
+        }
+        ++cost;
+    }
+    return cost;
+}
+
+unsigned int decimal_length(unsigned int value){
+    unsigned int length = 1;
+    while(value >= 10){
+        value /= 10;
+        ++length;
+    }
+    return length;
+}
+
+int init_ansi_screen(ansi_screen* screen, int in_fd, int out_fd){
+    screen->in_fd = in_fd;
+    screen->out_fd = out_fd;
+    screen->front = screen->back = NULL;
+    screen->out = NULL;
+    screen->cols = screen->rows = 0;
+    screen->redraw = false;
+    screen->num_keys = screen->next_key = 0;
+
+    //Same as curses' raw mode: keys arrive one at a time, unechoed, and ^C is just another key.
+    //Reads return straight away when no key is waiting.  Setting O_NONBLOCK instead would also
+    //make writes to the terminal fail whenever it is busy, since both share one open file
+    if(tcgetattr(in_fd, &screen->saved_mode) != 0)
+        return EXIT_ERR;
+    struct termios mode = screen->saved_mode;
+    cfmakeraw(&mode);
+    mode.c_cc[VMIN] = 0;
+    mode.c_cc[VTIME] = 0;
+    tcsetattr(in_fd, TCSANOW, &mode);
+
+    int status = resize_ansi_screen(screen);
+    if(status != NO_ERR){
+        free_ansi_screen(screen);
+        return status;
+    }
+    //Entering the screen already clears it
+    screen->redraw = false;
+    write_all(out_fd, ENTER_SCREEN, strlen(ENTER_SCREEN));
+    return NO_ERR;
+}
+
+void free_ansi_screen(ansi_screen* screen){
+    if(screen->out)
+        write_all(screen->out_fd, LEAVE_SCREEN, strlen(LEAVE_SCREEN));
+    tcsetattr(screen->in_fd, TCSANOW, &screen->saved_mode);
+    free(screen->front);
+    free(screen->back);
+    free(screen->out);
+    screen->front = screen->back = NULL;
+    screen->out = NULL;
+}
+
+//Picks up the terminal's size.  Everything is redrawn on the next flush.  If the buffers for the
+//new size can not be allocated, the screen keeps drawing at its old size
+int resize_ansi_screen(ansi_screen* screen){
+    struct winsize size;
+    if(ioctl(screen->out_fd, TIOCGWINSZ, &size) != 0 || size.ws_col == 0 || size.ws_row == 0)
+        return EXIT_ERR;
+
+    ansi_screen resized = *screen;
+    resized.cols = size.ws_col;
+    resized.rows = size.ws_row;
+    size_t cells = (size_t) resized.cols * resized.rows;
+    resized.front = malloc(cells * sizeof(uint16_t));
+    resized.back = malloc(cells * sizeof(uint16_t));
+    resized.out = malloc(output_capacity(&resized));
+    if(resized.front == NULL || resized.back == NULL || resized.out == NULL){
+        free(resized.front);
+        free(resized.back);
+        free(resized.out);
+        return OUT_OF_MEM;
+    }
+
+    free(screen->front);
+    free(screen->back);
+    free(screen->out);
+    *screen = resized;
+    for(size_t i = 0; i < cells; ++i)
+        screen->back[i] = ' ';
+    mark_screen_stale(screen);
+    return NO_ERR;
+}
+
+void mark_screen_stale(ansi_screen* screen){
+    size_t cells = (size_t) screen->cols * screen->rows;
+    for(size_t i = 0; i < cells; ++i)
+        screen->front[i] = STALE_CELL;
+    screen->redraw = true;
+}
+
+void ansi_put(ansi_screen* screen, unsigned int x, unsigned int y, uint16_t cell){
+    if(x < screen->cols && y < screen->rows)
+        screen->back[(size_t) y * screen->cols + x] = cell;
+}
+
+void ansi_print(ansi_screen* screen, unsigned int x, unsigned int y, const char* text){
+    for(; *text != '\0'; ++text, ++x)
+        ansi_put(screen, x, y, (unsigned char) *text);
+}
+
+void ansi_clear_line(ansi_screen* screen, unsigned int x, unsigned int y){
+    for(; x < screen->cols; ++x)
+        ansi_put(screen, x, y, ' ');
+}
+
+//Sends every cell that changed since the last flush, and returns how many bytes that took.  If
+//they could not all be written, it returns 0 and the next flush draws the whole screen again
+size_t flush_ansi_screen(ansi_screen* screen){
+    char* out = screen->out;
+    if(screen->redraw)
+        out = stpcpy(out, CLEAR_SCREEN);
+    screen->redraw = false;
+    //The attributes are always reset when the screen is entered or cleared, and restored after every flush
+    bool reverse = false;
+    unsigned int cursor_x = 0, cursor_y = 0;
+    bool cursor_known = false;
+
+    for(unsigned int y = 0; y < screen->rows; ++y){
+        uint16_t* back = screen->back + (size_t) y * screen->cols;
+        uint16_t* front = screen->front + (size_t) y * screen->cols;
+        for(unsigned int x = 0; x < screen->cols; ++x){
+            if(back[x] == front[x])
+                continue;
+
+            //On the same line, either write the unchanged cells in between again or move along the
+            //line, whichever is shorter.  Anywhere else needs the full cursor position
+            unsigned int from = x;
+            if(cursor_known && cursor_y == y){
+                unsigned int move_cost = decimal_length(x + 1) + 3;
+                if(rewrite_cost(back, cursor_x, x, reverse) <= move_cost)
+                    from = cursor_x;
+                else
+                    out += sprintf(out, "\x1b[%uG", x + 1);
+            }else
+                out += sprintf(out, "\x1b[%u;%uH", y + 1, x + 1);
+
+            for(unsigned int i = from; i <= x; ++i){
+                bool cell_reverse = back[i] & ANSI_REVERSE;
+                if(cell_reverse != reverse){
+                    out = stpcpy(out, cell_reverse ? REVERSE_ON : REVERSE_OFF);
+                    reverse = cell_reverse;
+                }
+                *out++ = (char) (back[i] & 0xFF);
+                front[i] = back[i];
+            }
+            cursor_x = x + 1;
+            cursor_y = y;
+            //Writing the last column leaves the cursor somewhere that depends on the terminal
+            cursor_known = (cursor_x < screen->cols);
+        }
+    }
+    if(reverse)
+        out = stpcpy(out, REVERSE_OFF);
+
+    size_t len = out - screen->out;
+    if(len && write_all(screen->out_fd, screen->out, len) != NO_ERR){
+        mark_screen_stale(screen);
+        return 0;
+    }
+    return len;
+}
+
+//Returns the next byte the terminal sent, or -1 once there are none left
+int read_key_byte(ansi_screen* screen){
+    if(screen->next_key == screen->num_keys){
+        ssize_t received = read(screen->in_fd, screen->keys, sizeof(screen->keys));
+        if(received <= 0)
+            return -1;
+        screen->num_keys = received;
+        screen->next_key = 0;
+    }
+    return (unsigned char) screen->keys[screen->next_key++];
+}
+
+//Returns the next key that was pressed, or -1 once there are none left.  Terminals send special
+//keys as an escape sequence, all in one go: ESC, then '[' or 'O', any parameter and
+//intermediate bytes, and a final byte from '@' to '~'.  The arrow keys become an ansi_key, and
+//any other sequence is dropped.  An escape with nothing right behind it is the escape key
+int read_ansi_key(ansi_screen* screen){
+    int ch = read_key_byte(screen);
+    if(ch != ANSI_KEY_ESCAPE)
+        return ch;
+    int introducer = read_key_byte(screen);
+    if(introducer != '[' && introducer != 'O'){
+        //Whatever came after the escape is a key of its own
+        if(introducer >= 0)
+            --screen->next_key;
+        return ANSI_KEY_ESCAPE;
+    }
+
+    int final = read_key_byte(screen);
+    while(final >= 0x20 && final <= 0x3F)
+        final = read_key_byte(screen);
+    switch(final){
+    case 'A':
+        return ANSI_KEY_UP;
+    case 'B':
+        return ANSI_KEY_DOWN;
+    case 'C':
+        return ANSI_KEY_RIGHT;
+    case 'D':
+        return ANSI_KEY_LEFT;
+    default:
+        return (final < 0) ? -1 : read_ansi_key(screen);
+    }
+}
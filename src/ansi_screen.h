@@ -0,0 +1,48 @@
+#ifndef ANSI_SCREEN_H
+#define ANSI_SCREEN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <termios.h>
+
+//Screen cells hold a character in the low byte, plus this flag for reverse video
+#define ANSI_REVERSE 0x100
+
+//Keys that arrive as escape sequences.  They are past every byte, so they can not be mistaken for one
+enum ansi_key{
+    ANSI_KEY_ESCAPE = 27,
+    ANSI_KEY_UP = 0x100,
+    ANSI_KEY_DOWN,
+    ANSI_KEY_RIGHT,
+    ANSI_KEY_LEFT
+};
+
+//Draws straight to the terminal with escape sequences.  Frames are drawn into the back buffer,
+//and flushing one only sends the cells that differ from the front buffer, in a single write
+typedef struct ansi_screen_t{
+    int in_fd;
+    int out_fd;
+    unsigned int cols;
+    unsigned int rows;
+    uint16_t* front;
+    uint16_t* back;
+    char* out;
+    //Set when what the terminal shows is unknown, so the next flush clears it and draws every cell
+    bool redraw;
+    struct termios saved_mode;
+    //Keys that were read but not handed out yet
+    char keys[64];
+    unsigned int num_keys;
+    unsigned int next_key;
+} ansi_screen;
+
+int init_ansi_screen(ansi_screen* screen, int in_fd, int out_fd);
+void free_ansi_screen(ansi_screen* screen);
+int resize_ansi_screen(ansi_screen* screen);
+void ansi_put(ansi_screen* screen, unsigned int x, unsigned int y, uint16_t cell);
+void ansi_print(ansi_screen* screen, unsigned int x, unsigned int y, const char* text);
+void ansi_clear_line(ansi_screen* screen, unsigned int x, unsigned int y);
+size_t flush_ansi_screen(ansi_screen* screen);
+int read_ansi_key(ansi_screen* screen);
+
+#endif
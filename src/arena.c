@@ -0,0 +1,36 @@
+#define _GNU_SOURCE
+
+#include <sys/mman.h>
+
+#include "arena.h"
+#include "errcode.h"
+
+size_t arena_align(size_t len){
+    return (len + ARENA_ALIGNMENT - 1) & ~((size_t) ARENA_ALIGNMENT - 1);
+}
+
+int init_arena(arena* memory, size_t len, enum page_mode mode){
+    //MAP_NORESERVE lets mostly empty fields be far larger than memory plus swap
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+    memory->base = MAP_FAILED;
+
+    if(mode == EXPLICIT_HUGE_PAGES){
+        memory->len = (len + HUGE_PAGE_SIZE - 1) & ~((size_t) HUGE_PAGE_SIZE - 1);
+        memory->base = mmap(NULL, memory->len, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+    }
+    if(memory->base == MAP_FAILED){
+        memory->len = len;
+        memory->base = mmap(NULL, memory->len, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if(memory->base == MAP_FAILED)
+            return OUT_OF_MEM;
+        if(mode != NORMAL_PAGES)
+            madvise(memory->base, memory->len, MADV_HUGEPAGE);
+    }
+    return NO_ERR;
+}
+
+void free_arena(arena* memory){
+    if(memory->base != MAP_FAILED && memory->base != NULL)
+        munmap(memory->base, memory->len);
+    memory->base = NULL;
+}
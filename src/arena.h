@@ -0,0 +1,28 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+//Every allocation out of an arena starts on a cache line
+#define ARENA_ALIGNMENT 64
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+enum page_mode{
+    NORMAL_PAGES = 0,
+    //Ask the kernel to back the arena with transparent huge pages where it can
+    TRANSPARENT_HUGE_PAGES,
+    //Map the arena from the reserved hugetlbfs pool, falling back to transparent huge pages
+    EXPLICIT_HUGE_PAGES
+};
+
+//One lazily mapped, zero filled region.  Pages that are never written cost no memory
+typedef struct arena_t{
+    void* base;
+    size_t len;
+} arena;
+
+size_t arena_align(size_t len);
+int init_arena(arena* memory, size_t len, enum page_mode mode);
+void free_arena(arena* memory);
+
+#endif
@@ -0,0 +1,249 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "gamefield.h"
+#include "step_engines.h"
+#include "errcode.h"
+
+//Throughput depends on the machine, so each machine records the baseline it is compared against with --update
+#define DEFAULT_BASELINE "bench_baseline.txt"
+//An engine fails once it is this many percent slower than its baseline
+#define DEFAULT_THRESHOLD 25.0
+//Every engine is timed at least MIN_RUNS times and for at least MIN_SECONDS, and the best run
+//counts.  The first run only maps the field's pages and warms up the caches, so it is not timed
+#define MIN_RUNS 3
+#define MAX_RUNS 200
+#define MIN_SECONDS 0.5
+#define MAX_RESULTS 64
+#define RESULT_NAME_LENGTH 64
+
+//A field that every engine advances the same number of generations, starting from the same cells
+typedef struct workload_t{
+    const char* name;
+    unsigned int width;
+    unsigned int height;
+    int seed_rate;
+    //Generations the field is run before any engine is timed on it
+    unsigned int settle;
+    unsigned int generations;
+} workload;
+
+typedef struct bench_result_t{
+    char name[RESULT_NAME_LENGTH];
+    //Millions of cells advanced by one generation per second
+    double throughput;
+} bench_result;
+
+typedef struct bench_args_t{
+    const char* baseline;
+    double threshold;
+    bool update;
+} bench_args;
+
+const workload WORKLOADS[] = {
+    //Almost every cell changes every generation
+    {"soup", 512, 512, 2, 0, 32},
+    //The same soup once it has settled into still lifes, oscillators and the odd glider
+    {"settled", 512, 512, 2, 3000, 32},
+    {NULL, 0, 0, 0, 0, 0}
+};
+
+int get_bench_opts(bench_args* args, int argc, char** argv);
+double now_seconds();
+void reset_field(field_data* field, field_data* start);
+int time_engine(const step_engine* engine, const workload* load, field_data* start, double* throughput);
+unsigned int read_baseline(const char* path, bench_result* results);
+int write_baseline(const char* path, bench_result* results, unsigned int num_results);
+bench_result* find_result(bench_result* results, unsigned int num_results, const char* name);
+
+double now_seconds(){
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+//Puts start's cells back into field, which must have the same size
+void reset_field(field_data* field, field_data* start){
+    memcpy(field->buffer_r->bitmap, start->buffer_r->bitmap, start->buffer_r->num_words * sizeof(uint32_t));
+    invalidate_field_stats(field);
+}
+
+//Starting and stopping an engine is left out of the time, since the game only does it once.  Every
+//run gets a fresh field, since a stopped engine may leave its field fit only for freeing
+int time_engine(const step_engine* engine, const workload* load, field_data* start, double* throughput){
+    int status = NO_ERR;
+    *throughput = 0;
+    double total = 0;
+    for(unsigned int run = 0; run <= MAX_RUNS && (run <= MIN_RUNS || total < MIN_SECONDS); ++run){
+        field_data field;
+        engine_run state;
+        status = init_field(&field, load->width, load->height, 0, start->edge_wrap, NULL);
+        if(status != NO_ERR)
+            break;
+        field.rules = start->rules;
+        reset_field(&field, start);
+        status = start_engine(engine, &state, &field);
+        if(status != NO_ERR){
+            free_field(&field);
+            break;
+        }
+        double begin = now_seconds();
+        status = run_engine(engine, &state, load->generations);
+        double seconds = now_seconds() - begin;
+        stop_engine(engine, &state);
+        free_field(&field);
+        if(status != NO_ERR)
+            break;
+
+        if(run == 0)
+            continue;
+        total += seconds;
+        double cells = (double) field.field_len * load->generations;
+        if(cells / seconds / 1e6 > *throughput)
+            *throughput = cells / seconds / 1e6;
+    }
+    return status;
+}
+
+//Each line of a baseline is a result's name and its throughput
+unsigned int read_baseline(const char* path, bench_result* results){
+    FILE* fp = fopen(path, "r");
+    if(fp == NULL)
+        return 0;
+    unsigned int num_results = 0;
+    while(num_results < MAX_RESULTS && fscanf(fp, "%63s %lf", results[num_results].name, &results[num_results].throughput) == 2)
+        ++num_results;
+    fclose(fp);
+    return num_results;
+}
+
+int write_baseline(const char* path, bench_result* results, unsigned int num_results){
+    FILE* fp = fopen(path, "w");
+    if(fp == NULL)
+        return FILE_NOT_FOUND;
+    for(unsigned int r = 0; r < num_results; ++r)
+        fprintf(fp, "%s %.1f\n", results[r].name, results[r].throughput);
+    fclose(fp);
+    return NO_ERR;
+}
+
+bench_result* find_result(bench_result* results, unsigned int num_results, const char* name){
+    for(unsigned int r = 0; r < num_results; ++r){
+        if(strcmp(results[r].name, name) == 0)
+            return &results[r];
+    }
+    return NULL;
+}
+
+int get_bench_opts(bench_args* args, int argc, char** argv){
+    static struct option long_options[] = {
+        {"baseline", required_argument, 0, 'b'},
+        {"threshold", required_argument, 0, 't'},
+        {"update", no_argument, 0, 'u'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+    int option_index = 0;
+    int argres = 0;
+    while((argres = getopt_long(argc, argv, "b:t:uh", long_options, &option_index)) != -1){
+        switch(argres){
+        case 'b':
+            args->baseline = optarg;
+            break;
+        case 't':
+            args->threshold = strtod(optarg, NULL);
+            if(!(args->threshold > 0 && args->threshold < 100)){
+                puts("Threshold must be a percentage between 0 and 100");
+                return ARG_ERR;
+            }
+            break;
+        case 'u':
+            args->update = true;
+            break;
+        case 'h':
+            return PRINT_HELP;
+        default:
+            return ARG_ERR;
+        }
+    }
+    return NO_ERR;
+}
+
+int main(int argc, char** argv){
+    bench_args args = {DEFAULT_BASELINE, DEFAULT_THRESHOLD, false};
+    int status = get_bench_opts(&args, argc, argv);
+    if(status == PRINT_HELP){
+        printf("Times every step engine, and fails if one is slower than its baseline or has none\n"
+               "  --baseline <path>  or -b <path>:  File the throughput is compared with (default %s)\n"
+               "  --threshold <num>  or -t <num>:   Percentage an engine may be slower by (default %.0f)\n"
+               "  --update           or -u:         Records this run as the new baseline\n", DEFAULT_BASELINE, DEFAULT_THRESHOLD);
+        return NO_ERR;
+    }
+    if(status != NO_ERR)
+        return status;
+
+    bench_result baseline[MAX_RESULTS];
+    unsigned int num_baseline = read_baseline(args.baseline, baseline);
+    //Without a baseline nothing could fail, so that is only allowed when recording one
+    if(num_baseline == 0 && !args.update){
+        printf("No baseline in %s.  Run with --update to record one on this machine\n", args.baseline);
+        return EXIT_ERR;
+    }
+    bench_result results[MAX_RESULTS];
+    unsigned int num_results = 0;
+    unsigned int regressions = 0;
+    unsigned int missing = 0;
+
+    for(const workload* load = WORKLOADS; load->name != NULL; ++load){
+        field_data start;
+        status = init_field_seeded(&start, load->width, load->height, load->seed_rate, 1, true, NULL);
+        if(status != NO_ERR)
+            return status;
+        for(unsigned int generation = 0; generation < load->settle; ++generation)
+            update_and_swap_fields(&start);
+
+        for(const step_engine* engine = STEP_ENGINES; engine->name != NULL && num_results < MAX_RESULTS; ++engine){
+            bench_result* result = &results[num_results++];
+            snprintf(result->name, RESULT_NAME_LENGTH, "%s/%s", load->name, engine->name);
+            status = time_engine(engine, load, &start, &result->throughput);
+            if(status != NO_ERR){
+                printf("%-24s could not be run\n", result->name);
+                free_field(&start);
+                return status;
+            }
+
+            printf("%-24s %10.1f Mcells/s", result->name, result->throughput);
+            bench_result* previous = find_result(baseline, num_baseline, result->name);
+            if(previous == NULL){
+                printf("  (no baseline)\n");
+                ++missing;
+                continue;
+            }
+            double change = 100 * (result->throughput / previous->throughput - 1);
+            bool regressed = change < -args.threshold;
+            printf("  %+6.1f%%%s\n", change, regressed ? "  REGRESSED" : "");
+            regressions += regressed;
+        }
+        free_field(&start);
+    }
+
+    if(args.update){
+        status = write_baseline(args.baseline, results, num_results);
+        if(status != NO_ERR){
+            printf("Could not write the baseline to %s\n", args.baseline);
+            return status;
+        }
+        printf("Recorded the baseline in %s\n", args.baseline);
+        return NO_ERR;
+    }
+    if(missing)
+        printf("%u results are not in %s.  Run with --update to record them\n", missing, args.baseline);
+    if(regressions)
+        printf("%u results are more than %.0f%% slower than %s\n", regressions, args.threshold, args.baseline);
+    return (missing || regressions) ? EXIT_ERR : NO_ERR;
+}
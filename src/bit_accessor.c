@@ -9,45 +9,45 @@ const unsigned int WORD_BITS = WORD_SIZE * 8;
 const unsigned int SUBWORD_MASK_LEN = 6;  //log_2(word_size)
 const unsigned int SUBWORD_MASK = 0b11111; //SUBWORD_MASK_LEN '1' bits
 
-unsigned int get_word_index(unsigned int bit_index){
+uint64_t get_word_index(uint64_t bit_index){
     return bit_index >> (SUBWORD_MASK_LEN - 1);
 }
 
-uint32_t get_bit_mask(unsigned int bit_index){
+uint32_t get_bit_mask(uint64_t bit_index){
     unsigned int subword_index = bit_index & SUBWORD_MASK;
     if(subword_index >= WORD_BITS)
         return 0;
     return ((unsigned int)1 << subword_index);
 }
 
-unsigned int read_bit(unsigned int bit_index, uint32_t* bitmap){
-    unsigned int word_index = get_word_index(bit_index);
+unsigned int read_bit(uint64_t bit_index, uint32_t* bitmap){
+    uint64_t word_index = get_word_index(bit_index);
     uint32_t bit_mask = get_bit_mask(bit_index);
     return bitmap[word_index] & bit_mask;
 }
 
-void set_bit_on(unsigned int bit_index, uint32_t* bitmap){
-    unsigned int word_index = get_word_index(bit_index);
+void set_bit_on(uint64_t bit_index, uint32_t* bitmap){
+    uint64_t word_index = get_word_index(bit_index);
     uint32_t bit_mask = get_bit_mask(bit_index);
 
     bitmap[word_index] |= bit_mask;
 }
 
-void set_bit_off(unsigned int bit_index, uint32_t* bitmap){
-    unsigned int word_index = get_word_index(bit_index);
+void set_bit_off(uint64_t bit_index, uint32_t* bitmap){
+    uint64_t word_index = get_word_index(bit_index);
     uint32_t bit_mask = get_bit_mask(bit_index);
 
     bitmap[word_index] &= ~bit_mask;
 }
 
-void flip_bit(unsigned int bit_index, unsigned int* bitmap){
-    unsigned int word_index = get_word_index(bit_index);
+void flip_bit(uint64_t bit_index, uint32_t* bitmap){
+    uint64_t word_index = get_word_index(bit_index);
     uint32_t bit_mask = get_bit_mask(bit_index);
 
     bitmap[word_index] ^= bit_mask;
 }
 
-void set_bit(bit_accessor* accessor, unsigned int bit_index, bool value){
+void set_bit(bit_accessor* accessor, uint64_t bit_index, bool value){
     if(bit_index >= accessor->num_bits)
         return;
     if(value)
@@ -56,20 +56,20 @@ void set_bit(bit_accessor* accessor, unsigned int bit_index, bool value){
         set_bit_off(bit_index, accessor->bitmap);
 }
 
-void toggle_bit(bit_accessor* accessor, unsigned int bit_index){
+void toggle_bit(bit_accessor* accessor, uint64_t bit_index){
     if(bit_index >= accessor->num_bits)
         return;
     flip_bit(bit_index, accessor->bitmap);
 }
 
-bool get_bit(bit_accessor* accessor, unsigned int bit_index){
+bool get_bit(bit_accessor* accessor, uint64_t bit_index){
     if(bit_index >= accessor->num_bits)
         return false;
     return read_bit(bit_index, accessor->bitmap);
 }
 
-unsigned int num_words_for_bitmap(unsigned int num_bits){
-    unsigned int min_words_needed = (num_bits / WORD_BITS);
+uint64_t num_words_for_bitmap(uint64_t num_bits){
+    uint64_t min_words_needed = (num_bits / WORD_BITS);
 
     if((num_bits) % WORD_BITS == 0)
         return min_words_needed;
@@ -92,19 +92,29 @@ void clear_all_bits(bit_accessor* accessor){
     memset(accessor->bitmap, 0, accessor->num_words * WORD_SIZE);
 }
 
-int init_accessor(bit_accessor* accessor, unsigned int num_bits){
+int init_accessor(bit_accessor* accessor, uint64_t num_bits){
     accessor->num_words = num_words_for_bitmap(num_bits);
-    unsigned int bitmap_len = WORD_SIZE * accessor->num_words;
+    size_t bitmap_len = WORD_SIZE * accessor->num_words;
 
     accessor->bitmap = malloc(bitmap_len);
     if(accessor->bitmap == NULL)
         return OUT_OF_MEM;
 
     accessor->num_bits = num_bits;
+    accessor->owns_bitmap = true;
     clear_all_bits(accessor);
     return NO_ERR;
 }
 
+//The bitmap must already be zeroed, so that freshly mapped pages are never touched here
+void init_accessor_at(bit_accessor* accessor, uint64_t num_bits, uint32_t* zeroed_bitmap){
+    accessor->num_words = num_words_for_bitmap(num_bits);
+    accessor->num_bits = num_bits;
+    accessor->bitmap = zeroed_bitmap;
+    accessor->owns_bitmap = false;
+}
+
 void free_accessor(bit_accessor* accessor){
-    free(accessor->bitmap);
+    if(accessor->owns_bitmap)
+        free(accessor->bitmap);
 }
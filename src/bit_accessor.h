@@ -6,16 +6,23 @@
 
 typedef struct bit_accessor_t{
     uint32_t* bitmap;
-    unsigned int num_bits;
-    unsigned int num_words;
+    uint64_t num_bits;
+    uint64_t num_words;
+    //False when the bitmap lives in memory that belongs to someone else, eg a field's arena
+    bool owns_bitmap;
 }bit_accessor;
 
-int init_accessor(bit_accessor* accessor, unsigned int num_bits);
+extern const unsigned int WORD_BITS;
+
+uint64_t num_words_for_bitmap(uint64_t num_bits);
+
+int init_accessor(bit_accessor* accessor, uint64_t num_bits);
+void init_accessor_at(bit_accessor* accessor, uint64_t num_bits, uint32_t* zeroed_bitmap);
 void free_accessor(bit_accessor* accessor);
 
 void clear_all_bits(bit_accessor* accessor);
-void set_bit(bit_accessor* accessor, unsigned int bit_index, bool value);
-bool get_bit(bit_accessor* accessor, unsigned int bit_index);
-void toggle_bit(bit_accessor* accessor, unsigned int bit_index);
+void set_bit(bit_accessor* accessor, uint64_t bit_index, bool value);
+bool get_bit(bit_accessor* accessor, uint64_t bit_index);
+void toggle_bit(bit_accessor* accessor, uint64_t bit_index);
 
 #endif
@@ -0,0 +1,340 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "broadcast.h"
+#include "errcode.h"
+
+#define VIEWER_BUFFER_LENGTH (64 * 1024)
+
+int open_socket_address(const char* path, struct sockaddr_un* address);
+bool socket_is_stale(const char* path);
+size_t build_message(broadcast_server* server, uint32_t* frame, uint32_t* previous, uint64_t generation);
+void close_viewer(broadcast_server* server, unsigned int index);
+int flush_viewer(broadcast_server* server, viewer_connection* viewer);
+int send_message(broadcast_server* server, viewer_connection* viewer, size_t len);
+int catch_up_viewer(broadcast_server* server, viewer_connection* viewer);
+void accept_viewers(broadcast_server* server);
+int handle_message(broadcast_viewer* viewer, frame_header* header, uint8_t* payload);
+
+int open_socket_address(const char* path, struct sockaddr_un* address){
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    if(strlen(path) >= sizeof(address->sun_path))
+        return -1;
+    strcpy(address->sun_path, path);
+    return socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+}
+
+//Whether the socket at path was left behind by a server that did not shut down cleanly.  Nothing
+//refuses a connection to a socket that is still being listened on, even if its backlog is full
+bool socket_is_stale(const char* path){
+    struct sockaddr_un address;
+    int fd = open_socket_address(path, &address);
+    if(fd < 0)
+        return false;
+    bool stale = connect(fd, (struct sockaddr*) &address, sizeof(address)) != 0 && errno == ECONNREFUSED;
+    close(fd);
+    return stale;
+}
+
+int init_broadcast_server(broadcast_server* server, const char* path, field_data* field, event_loop* loop){
+    struct sockaddr_un address;
+    server->path = path;
+    server->loop = loop;
+    server->num_viewers = 0;
+    server->dropped_frames = 0;
+    server->num_words = field->buffer_r->num_words;
+    server->listen_fd = open_socket_address(path, &address);
+    if(server->listen_fd < 0)
+        return BROADCAST_FAIL;
+
+    //A socket left behind by a server that did not shut down cleanly would make bind fail.  One
+    //that a server is still listening on is left alone, so bind fails instead of taking it over
+    struct stat info;
+    if(stat(path, &info) == 0 && S_ISSOCK(info.st_mode) && socket_is_stale(path))
+        unlink(path);
+    if(bind(server->listen_fd, (struct sockaddr*) &address, sizeof(address)) != 0
+       || listen(server->listen_fd, MAX_VIEWERS) != 0
+       || (loop && watch_fd(loop, server->listen_fd, EPOLLIN, SOCKET_EVENT) != NO_ERR)){
+        close(server->listen_fd);
+        return BROADCAST_FAIL;
+    }
+
+    server->message_capacity = sizeof(frame_header) + max_encoded_len(server->num_words);
+    server->message = malloc(server->message_capacity);
+    server->previous = calloc(server->num_words, sizeof(uint32_t));
+    if(server->message == NULL || server->previous == NULL){
+        free(server->message);
+        free(server->previous);
+        close(server->listen_fd);
+        unlink(path);
+        return OUT_OF_MEM;
+    }
+    memcpy(server->previous, field->buffer_r->bitmap, server->num_words * sizeof(uint32_t));
+    server->generation = 0;
+    server->width = field->size_x;
+    server->height = field->size_y;
+    server->hexagonal = (field->rules.neighbourhood == HEXAGONAL);
+    return NO_ERR;
+}
+
+//Encodes a frame into the shared message buffer.  previous is NULL for a key frame
+size_t build_message(broadcast_server* server, uint32_t* frame, uint32_t* previous, uint64_t generation){
+    frame_header header = {
+        .magic = FRAME_MAGIC,
+        .flags = (previous ? 0 : FRAME_KEY) | (server->hexagonal ? FRAME_HEXAGONAL : 0),
+        .width = server->width,
+        .height = server->height,
+        .generation = generation
+    };
+    header.payload_len = encode_frame(frame, previous, server->num_words, server->message + sizeof(header));
+    memcpy(server->message, &header, sizeof(header));
+    return sizeof(header) + header.payload_len;
+}
+
+void close_viewer(broadcast_server* server, unsigned int index){
+    viewer_connection* viewer = &server->viewers[index];
+    if(server->loop)
+        unwatch_fd(server->loop, viewer->fd);
+    close(viewer->fd);
+    free(viewer->pending);
+    server->viewers[index] = server->viewers[--server->num_viewers];
+}
+
+//Sends as much of a viewer's unsent frame as its socket takes without blocking
+int flush_viewer(broadcast_server* server, viewer_connection* viewer){
+    while(viewer->pending_sent < viewer->pending_len){
+        ssize_t sent = send(viewer->fd, viewer->pending + viewer->pending_sent, viewer->pending_len - viewer->pending_sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if(sent < 0)
+            return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? NO_ERR : BROADCAST_FAIL;
+        viewer->pending_sent += sent;
+    }
+    //Nothing left to send, so stop waiting for the socket to become writable
+    if(viewer->pending_len && server->loop)
+        watch_fd(server->loop, viewer->fd, EPOLLIN, SOCKET_EVENT);
+    viewer->pending_len = viewer->pending_sent = 0;
+    return NO_ERR;
+}
+
+//Sends the message in the shared buffer, and keeps whatever does not fit in the socket for later
+int send_message(broadcast_server* server, viewer_connection* viewer, size_t len){
+    ssize_t sent = send(viewer->fd, server->message, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if(sent < 0){
+        if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            return BROADCAST_FAIL;
+        sent = 0;
+    }
+    if((size_t) sent == len)
+        return NO_ERR;
+
+    uint8_t* pending = realloc(viewer->pending, len - sent);
+    if(pending == NULL)
+        return OUT_OF_MEM;
+    memcpy(pending, server->message + sent, len - sent);
+    viewer->pending = pending;
+    viewer->pending_len = len - sent;
+    viewer->pending_sent = 0;
+    if(server->loop)
+        watch_fd(server->loop, viewer->fd, EPOLLIN | EPOLLOUT, SOCKET_EVENT);
+    return NO_ERR;
+}
+
+//Sends a viewer that skipped frames the last generation that was published as a key frame, as
+//soon as it has taken everything it was sent before, so it does not wait for the next generation
+int catch_up_viewer(broadcast_server* server, viewer_connection* viewer){
+    if(!viewer->needs_key || viewer->pending_len)
+        return NO_ERR;
+    viewer->needs_key = false;
+    return send_message(server, viewer, build_message(server, server->previous, NULL, server->generation));
+}
+
+void accept_viewers(broadcast_server* server){
+    while(true){
+        int fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd < 0)
+            return;
+        if(server->num_viewers == MAX_VIEWERS){
+            close(fd);
+            continue;
+        }
+        viewer_connection* viewer = &server->viewers[server->num_viewers++];
+        *viewer = (viewer_connection) {.fd = fd, .needs_key = false};
+        if(server->loop)
+            watch_fd(server->loop, fd, EPOLLIN, SOCKET_EVENT);
+
+        //Show new viewers the current generation straight away, even if the game is paused
+        size_t len = build_message(server, server->previous, NULL, server->generation);
+        if(send_message(server, viewer, len) != NO_ERR)
+            close_viewer(server, server->num_viewers - 1);
+    }
+}
+
+//Accepts new viewers, finishes sending frames that did not fit in a socket and drops viewers that left
+void serve_viewers(broadcast_server* server){
+    accept_viewers(server);
+    for(unsigned int i = server->num_viewers; i-- > 0;){
+        viewer_connection* viewer = &server->viewers[i];
+        //Viewers never send anything, so a readable socket means it was closed
+        char byte;
+        ssize_t received = recv(viewer->fd, &byte, sizeof(byte), MSG_DONTWAIT);
+        bool closed = (received == 0) || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+        if(closed || flush_viewer(server, viewer) != NO_ERR || catch_up_viewer(server, viewer) != NO_ERR)
+            close_viewer(server, i);
+    }
+}
+
+void broadcast_frame(broadcast_server* server, field_data* field, uint64_t generation){
+    uint32_t* frame = field->buffer_r->bitmap;
+    size_t len = 0;
+
+    //Everyone who is up to date gets the same delta frame, so it is only encoded once
+    for(unsigned int i = server->num_viewers; i-- > 0;){
+        viewer_connection* viewer = &server->viewers[i];
+        if(flush_viewer(server, viewer) != NO_ERR){
+            close_viewer(server, i);
+            continue;
+        }
+        //Never wait for a slow viewer.  It misses this frame and gets a key frame once it catches up
+        if(viewer->pending_len){
+            viewer->needs_key = true;
+            ++server->dropped_frames;
+            continue;
+        }
+        if(viewer->needs_key)
+            continue;
+        if(len == 0)
+            len = build_message(server, frame, server->previous, generation);
+        if(send_message(server, viewer, len) != NO_ERR)
+            close_viewer(server, i);
+    }
+
+    len = 0;
+    for(unsigned int i = server->num_viewers; i-- > 0;){
+        viewer_connection* viewer = &server->viewers[i];
+        if(!viewer->needs_key || viewer->pending_len)
+            continue;
+        if(len == 0)
+            len = build_message(server, frame, NULL, generation);
+        viewer->needs_key = false;
+        if(send_message(server, viewer, len) != NO_ERR)
+            close_viewer(server, i);
+    }
+
+    memcpy(server->previous, frame, server->num_words * sizeof(uint32_t));
+    server->generation = generation;
+}
+
+void free_broadcast_server(broadcast_server* server){
+    while(server->num_viewers)
+        close_viewer(server, server->num_viewers - 1);
+    if(server->loop)
+        unwatch_fd(server->loop, server->listen_fd);
+    close(server->listen_fd);
+    unlink(server->path);
+    free(server->message);
+    free(server->previous);
+}
+
+int connect_viewer(broadcast_viewer* viewer, const char* path, event_loop* loop){
+    struct sockaddr_un address;
+    viewer->has_field = false;
+    viewer->generation = 0;
+    viewer->buffer_len = 0;
+    viewer->fd = open_socket_address(path, &address);
+    if(viewer->fd < 0)
+        return BROADCAST_FAIL;
+
+    //Connecting to a UNIX domain socket never has to wait, unless the server's backlog is full
+    if(connect(viewer->fd, (struct sockaddr*) &address, sizeof(address)) != 0
+       || (loop && watch_fd(loop, viewer->fd, EPOLLIN, SOCKET_EVENT) != NO_ERR)){
+        close(viewer->fd);
+        return BROADCAST_FAIL;
+    }
+    viewer->buffer_capacity = VIEWER_BUFFER_LENGTH;
+    viewer->buffer = malloc(viewer->buffer_capacity);
+    if(viewer->buffer == NULL){
+        close(viewer->fd);
+        return OUT_OF_MEM;
+    }
+    return NO_ERR;
+}
+
+int handle_message(broadcast_viewer* viewer, frame_header* header, uint8_t* payload){
+    bool key = header->flags & FRAME_KEY;
+    bool same_size = viewer->has_field && viewer->field.size_x == header->width && viewer->field.size_y == header->height;
+    //A delta frame means nothing without the frame before it
+    if(!key && !same_size)
+        return NO_ERR;
+    if(!same_size){
+        if(viewer->has_field)
+            free_field(&viewer->field);
+        viewer->has_field = false;
+        int status = init_field(&viewer->field, header->width, header->height, 0, false, NULL);
+        if(status != NO_ERR)
+            return status;
+        viewer->has_field = true;
+    }
+
+    viewer->field.rules.neighbourhood = (header->flags & FRAME_HEXAGONAL) ? HEXAGONAL : MOORE;
+    viewer->generation = header->generation;
+    return decode_frame(payload, header->payload_len, viewer->field.buffer_r->bitmap, viewer->field.buffer_r->num_words, key);
+}
+
+//Reads every frame that has arrived.  new_frame tells whether the field changed
+int receive_frames(broadcast_viewer* viewer, bool* new_frame){
+    *new_frame = false;
+    while(true){
+        if(viewer->buffer_len == viewer->buffer_capacity){
+            uint8_t* grown = realloc(viewer->buffer, 2 * viewer->buffer_capacity);
+            if(grown == NULL)
+                return OUT_OF_MEM;
+            viewer->buffer = grown;
+            viewer->buffer_capacity *= 2;
+        }
+        ssize_t received = recv(viewer->fd, viewer->buffer + viewer->buffer_len, viewer->buffer_capacity - viewer->buffer_len, MSG_DONTWAIT);
+        if(received == 0)
+            return BROADCAST_FAIL;
+        if(received < 0){
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            if(errno == EINTR)
+                continue;
+            return BROADCAST_FAIL;
+        }
+        viewer->buffer_len += received;
+    }
+
+    size_t used = 0;
+    while(viewer->buffer_len - used >= sizeof(frame_header)){
+        frame_header header;
+        memcpy(&header, viewer->buffer + used, sizeof(header));
+        uint64_t num_words = (uint64_t) num_words_for_bitmap(header.width) * header.height;
+        if(header.magic != FRAME_MAGIC || header.width == 0 || header.height == 0 || header.payload_len > max_encoded_len(num_words))
+            return FRAME_FORMAT_FAIL;
+        if(viewer->buffer_len - used - sizeof(header) < header.payload_len)
+            break;
+
+        int status = handle_message(viewer, &header, viewer->buffer + used + sizeof(header));
+        if(status != NO_ERR)
+            return status;
+        *new_frame |= viewer->has_field;
+        used += sizeof(header) + header.payload_len;
+    }
+    memmove(viewer->buffer, viewer->buffer + used, viewer->buffer_len - used);
+    viewer->buffer_len -= used;
+    return NO_ERR;
+}
+
+void free_viewer(broadcast_viewer* viewer){
+    if(viewer->has_field)
+        free_field(&viewer->field);
+    free(viewer->buffer);
+    close(viewer->fd);
+}
@@ -0,0 +1,59 @@
+#ifndef BROADCAST_H
+#define BROADCAST_H
+
+#include "gamefield.h"
+#include "event_loop.h"
+#include "frame_codec.h"
+
+#define MAX_VIEWERS 16
+
+//A viewer that has not taken all of its last frame yet skips frames until it has, and is then
+//sent a key frame of the latest generation to catch up, without waiting for the next one
+typedef struct viewer_connection_t{
+    int fd;
+    uint8_t* pending;
+    size_t pending_len;
+    size_t pending_sent;
+    bool needs_key;
+} viewer_connection;
+
+//Publishes every generation of one simulation to any number of viewers on a UNIX domain socket
+typedef struct broadcast_server_t{
+    int listen_fd;
+    const char* path;
+    event_loop* loop;
+    viewer_connection viewers[MAX_VIEWERS];
+    unsigned int num_viewers;
+    //The last frame that was published, which the next delta frame is encoded against
+    uint32_t* previous;
+    uint64_t generation;
+    uint64_t num_words;
+    unsigned int width;
+    unsigned int height;
+    bool hexagonal;
+    uint8_t* message;
+    size_t message_capacity;
+    uint64_t dropped_frames;
+} broadcast_server;
+
+//Attaches to a broadcast and keeps a copy of the field it is showing
+typedef struct broadcast_viewer_t{
+    int fd;
+    uint8_t* buffer;
+    size_t buffer_len;
+    size_t buffer_capacity;
+    field_data field;
+    bool has_field;
+    uint64_t generation;
+} broadcast_viewer;
+
+int init_broadcast_server(broadcast_server* server, const char* path, field_data* field, event_loop* loop);
+void serve_viewers(broadcast_server* server);
+void broadcast_frame(broadcast_server* server, field_data* field, uint64_t generation);
+void free_broadcast_server(broadcast_server* server);
+
+int connect_viewer(broadcast_viewer* viewer, const char* path, event_loop* loop);
+int receive_frames(broadcast_viewer* viewer, bool* new_frame);
+void free_viewer(broadcast_viewer* viewer);
+
+#endif
@@ -0,0 +1,620 @@
+#include <inttypes.h>
+
+#include "census.h"
+#include "errcode.h"
+
+#define RUNS_INITIAL_LENGTH 1024
+#define FNV_OFFSET 0xCBF29CE484222325ULL
+#define FNV_PRIME 0x100000001B3ULL
+//Hash of objects that touch themselves around a wrapping field, and so have no shape of their own
+#define WRAPPING_HASH 0
+#define NUM_ORIENTATIONS 8
+
+//A horizontal span of live cells, from x_start to x_end inclusive
+typedef struct cell_run_t{
+    unsigned int x_start;
+    unsigned int x_end;
+    unsigned int y;
+} cell_run;
+
+//Union-find over runs.  shift holds how far a run has to be moved, in whole field widths and
+//heights, to line up with its parent, which puts objects that cross a wrapping edge back together
+typedef struct run_labels_t{
+    cell_run* runs;
+    size_t num_runs;
+    size_t capacity;
+    size_t* parent;
+    uint64_t* size;
+    int64_t* shift_x;
+    int64_t* shift_y;
+    bool* wraps;
+} run_labels;
+
+typedef struct cell_point_t{
+    int64_t x;
+    int64_t y;
+} cell_point;
+
+typedef struct object_hash_t{
+    uint64_t hash;
+    uint64_t cells;
+} object_hash;
+
+typedef struct known_object_t{
+    const char* name;
+    //Rows of the object separated by '$', with 'O' for a live cell
+    const char* cells;
+    uint64_t hash;
+} known_object;
+
+//Every phase of an object that is a different shape gets its own line
+known_object known_objects[] = {
+    {"block", "OO$OO", 0},
+    {"blinker", "OOO", 0},
+    {"beehive", ".OO.$O..O$.OO.", 0},
+    {"loaf", ".OO.$O..O$.O.O$..O.", 0},
+    {"boat", "OO.$O.O$.O.", 0},
+    {"ship", "OO.$O.O$.OO", 0},
+    {"tub", ".O.$O.O$.O.", 0},
+    {"pond", ".OO.$O..O$O..O$.OO.", 0},
+    {"long boat", "OO..$O.O.$.O.O$..O.", 0},
+    {"glider", ".O.$..O$OOO", 0},
+    {"glider", "O.O$.OO$.O.", 0},
+    {"glider", "..O$O.O$.OO", 0},
+    {"glider", "O..$.OO$OO.", 0},
+    {NULL, NULL, 0}
+};
+pthread_once_t known_objects_once = PTHREAD_ONCE_INIT;
+
+int add_run(run_labels* labels, unsigned int x_start, unsigned int x_end, unsigned int y);
+int find_runs(field_data* field, run_labels* labels, size_t* row_start);
+size_t find_label(run_labels* labels, size_t run, int64_t* shift_x, int64_t* shift_y);
+void join_runs(run_labels* labels, size_t a, size_t b, int64_t dx, int64_t dy);
+void join_rows(field_data* field, run_labels* labels, size_t* row_start, unsigned int upper, unsigned int lower, int64_t dy);
+void neighbour_reach(field_data* field, unsigned int lower, unsigned int* left, unsigned int* right);
+int compare_points(const void* a, const void* b);
+int compare_object_hashes(const void* a, const void* b);
+int compare_entries(const void* a, const void* b);
+uint64_t canonical_hash(cell_point* cells, cell_point* scratch, uint64_t num_cells);
+void hash_known_objects(void);
+int name_object(census_entry* entry);
+int count_objects(census* result, object_hash* hashes, uint64_t num_objects);
+void copy_changed_words(uint32_t* dest, uint32_t* src, uint64_t num_words);
+void* census_worker_main(void* arg);
+
+int add_run(run_labels* labels, unsigned int x_start, unsigned int x_end, unsigned int y){
+    if(labels->num_runs == labels->capacity){
+        size_t capacity = labels->capacity ? 2 * labels->capacity : RUNS_INITIAL_LENGTH;
+        cell_run* grown = realloc(labels->runs, capacity * sizeof(cell_run));
+        if(grown == NULL)
+            return OUT_OF_MEM;
+        labels->runs = grown;
+        labels->capacity = capacity;
+    }
+    labels->runs[labels->num_runs++] = (cell_run) {x_start, x_end, y};
+    return NO_ERR;
+}
+
+//Reads the runs of every row straight out of the bitmap words.  The runs of row y are
+//runs[row_start[y]] up to runs[row_start[y + 1]], from left to right
+int find_runs(field_data* field, run_labels* labels, size_t* row_start){
+    for(unsigned int y = 0; y < field->size_y; ++y){
+        row_start[y] = labels->num_runs;
+        uint32_t* row = field_row(field, field->buffer_r, y);
+        bool open = false;
+        unsigned int x_start = 0;
+
+        for(unsigned int word = 0; word < field->row_words; ++word){
+            uint32_t bits = row[word];
+            unsigned int pos = 0;
+            //Skip words that neither start nor end a run
+            if((open && bits == ~(uint32_t) 0) || (!open && bits == 0))
+                continue;
+            while(pos < 32){
+                if(!open){
+                    uint32_t ones = bits & (~(uint32_t) 0 << pos);
+                    if(ones == 0)
+                        break;
+                    pos = __builtin_ctz(ones);
+                    x_start = word * 32 + pos;
+                    open = true;
+                }
+                uint32_t zeros = ~bits & (~(uint32_t) 0 << pos);
+                if(zeros == 0)
+                    break;
+                pos = __builtin_ctz(zeros);
+                if(add_run(labels, x_start, word * 32 + pos - 1, y) != NO_ERR)
+                    return OUT_OF_MEM;
+                open = false;
+            }
+        }
+        if(open && add_run(labels, x_start, field->size_x - 1, y) != NO_ERR)
+            return OUT_OF_MEM;
+    }
+    row_start[field->size_y] = labels->num_runs;
+    return NO_ERR;
+}
+
+size_t find_label(run_labels* labels, size_t run, int64_t* shift_x, int64_t* shift_y){
+    size_t root = run;
+    int64_t total_x = 0, total_y = 0;
+    while(labels->parent[root] != root){
+        total_x += labels->shift_x[root];
+        total_y += labels->shift_y[root];
+        root = labels->parent[root];
+    }
+    *shift_x = total_x;
+    *shift_y = total_y;
+
+    //Point everything on the way straight at the root
+    while(run != root){
+        size_t next = labels->parent[run];
+        int64_t step_x = labels->shift_x[run], step_y = labels->shift_y[run];
+        labels->parent[run] = root;
+        labels->shift_x[run] = total_x;
+        labels->shift_y[run] = total_y;
+        total_x -= step_x;
+        total_y -= step_y;
+        run = next;
+    }
+    return root;
+}
+
+//Joins two touching runs, where b sits (dx, dy) further along than a once both are unwrapped
+void join_runs(run_labels* labels, size_t a, size_t b, int64_t dx, int64_t dy){
+    int64_t a_x, a_y, b_x, b_y;
+    size_t root_a = find_label(labels, a, &a_x, &a_y);
+    size_t root_b = find_label(labels, b, &b_x, &b_y);
+    if(root_a == root_b){
+        //Reaching the same run along two different paths means the object wraps all the way around
+        if(b_x - a_x != dx || b_y - a_y != dy)
+            labels->wraps[root_a] = true;
+        return;
+    }
+
+    int64_t root_x = dx + a_x - b_x, root_y = dy + a_y - b_y;
+    if(labels->size[root_a] < labels->size[root_b]){
+        labels->parent[root_a] = root_b;
+        labels->shift_x[root_a] = -root_x;
+        labels->shift_y[root_a] = -root_y;
+        labels->size[root_b] += labels->size[root_a];
+        labels->wraps[root_b] |= labels->wraps[root_a];
+    }else{
+        labels->parent[root_b] = root_a;
+        labels->shift_x[root_b] = root_x;
+        labels->shift_y[root_b] = root_y;
+        labels->size[root_a] += labels->size[root_b];
+        labels->wraps[root_a] |= labels->wraps[root_b];
+    }
+}
+
+//How far to the left and right of a cell in the lower row its neighbours in the row above reach,
+//following the same offsets as count_neighbours
+void neighbour_reach(field_data* field, unsigned int lower, unsigned int* left, unsigned int* right){
+    if(field->rules.neighbourhood == VON_NEUMANN){
+        *left = 0;
+        *right = 0;
+    }else if(field->rules.neighbourhood == HEXAGONAL){
+        bool odd = is_odd_row(field, lower);
+        *left = odd ? 0 : 1;
+        *right = odd ? 1 : 0;
+    }else{
+        *left = 1;
+        *right = 1;
+    }
+}
+
+//Joins every run of the upper row to the runs of the lower row it touches.  Which runs touch
+//diagonally depends on the field's neighbourhood
+void join_rows(field_data* field, run_labels* labels, size_t* row_start, unsigned int upper, unsigned int lower, int64_t dy){
+    size_t a = row_start[upper], a_end = row_start[upper + 1];
+    size_t b = row_start[lower], b_end = row_start[lower + 1];
+    if(a == a_end || b == b_end)
+        return;
+
+    unsigned int left, right;
+    neighbour_reach(field, lower, &left, &right);
+    cell_run* runs = labels->runs;
+    while(a < a_end && b < b_end){
+        if(runs[a].x_end + left < runs[b].x_start)
+            ++a;
+        else if(runs[b].x_end + right < runs[a].x_start)
+            ++b;
+        else{
+            join_runs(labels, a, b, 0, dy);
+            //Runs in a row are at least one cell apart and a cell reaches at most one column to
+            //either side, so the run that ends first can not touch the next run of the other row
+            if(runs[a].x_end < runs[b].x_end + right)
+                ++a;
+            else
+                ++b;
+        }
+    }
+
+    if(field->edge_wrap){
+        unsigned int last = field->size_x - 1;
+        a = row_start[upper];
+        b = row_start[lower];
+        if(left && runs[a_end - 1].x_end == last && runs[b].x_start == 0)
+            join_runs(labels, a_end - 1, b, field->size_x, dy);
+        if(right && runs[a].x_start == 0 && runs[b_end - 1].x_end == last)
+            join_runs(labels, a, b_end - 1, -(int64_t) field->size_x, dy);
+    }
+}
+
+int compare_points(const void* a, const void* b){
+    const cell_point* p = a;
+    const cell_point* q = b;
+    if(p->y != q->y)
+        return (p->y < q->y) ? -1 : 1;
+    if(p->x != q->x)
+        return (p->x < q->x) ? -1 : 1;
+    return 0;
+}
+
+//Hashes the shape of an object in all 8 orientations and keeps the smallest, so the result
+//does not depend on where the object is or which way it faces
+uint64_t canonical_hash(cell_point* cells, cell_point* scratch, uint64_t num_cells){
+    uint64_t best = UINT64_MAX;
+    for(int orientation = 0; orientation < NUM_ORIENTATIONS; ++orientation){
+        int64_t min_x = INT64_MAX, min_y = INT64_MAX;
+        for(uint64_t i = 0; i < num_cells; ++i){
+            int64_t x = (orientation & 1) ? -cells[i].x : cells[i].x;
+            int64_t y = (orientation & 2) ? -cells[i].y : cells[i].y;
+            scratch[i] = (orientation & 4) ? (cell_point) {y, x} : (cell_point) {x, y};
+            if(scratch[i].x < min_x)
+                min_x = scratch[i].x;
+            if(scratch[i].y < min_y)
+                min_y = scratch[i].y;
+        }
+        for(uint64_t i = 0; i < num_cells; ++i){
+            scratch[i].x -= min_x;
+            scratch[i].y -= min_y;
+        }
+        qsort(scratch, num_cells, sizeof(cell_point), compare_points);
+
+        uint64_t hash = FNV_OFFSET;
+        for(uint64_t i = 0; i < num_cells; ++i){
+            hash = (hash ^ (uint64_t) scratch[i].x) * FNV_PRIME;
+            hash = (hash ^ (uint64_t) scratch[i].y) * FNV_PRIME;
+        }
+        if(hash == WRAPPING_HASH)
+            ++hash;
+        if(hash < best)
+            best = hash;
+    }
+    return best;
+}
+
+void hash_known_objects(void){
+    for(known_object* object = known_objects; object->name != NULL; ++object){
+        cell_point cells[64], scratch[64];
+        uint64_t num_cells = 0;
+        int64_t x = 0, y = 0;
+        for(const char* c = object->cells; *c != '\0'; ++c){
+            if(*c == '$'){
+                x = 0;
+                ++y;
+                continue;
+            }
+            if(*c == 'O')
+                cells[num_cells++] = (cell_point) {x, y};
+            ++x;
+        }
+        object->hash = canonical_hash(cells, scratch, num_cells);
+    }
+}
+
+//Returns the index of the known object, or -1 if the object has no name of its own
+int name_object(census_entry* entry){
+    if(entry->hash == WRAPPING_HASH){
+        snprintf(entry->name, CENSUS_NAME_LENGTH, "wrapping object");
+        return -1;
+    }
+    for(int k = 0; known_objects[k].name != NULL; ++k){
+        if(known_objects[k].hash == entry->hash){
+            snprintf(entry->name, CENSUS_NAME_LENGTH, "%s", known_objects[k].name);
+            return k;
+        }
+    }
+    snprintf(entry->name, CENSUS_NAME_LENGTH, "%" PRIu64 "-cell #%06" PRIx64, entry->cells, entry->hash & 0xFFFFFF);
+    return -1;
+}
+
+int compare_object_hashes(const void* a, const void* b){
+    const object_hash* p = a;
+    const object_hash* q = b;
+    if(p->hash != q->hash)
+        return (p->hash < q->hash) ? -1 : 1;
+    return 0;
+}
+
+int compare_entries(const void* a, const void* b){
+    const census_entry* p = a;
+    const census_entry* q = b;
+    if(p->count != q->count)
+        return (p->count > q->count) ? -1 : 1;
+    return strcmp(p->name, q->name);
+}
+
+//Tallies the objects by shape.  Phases of the same known object are merged under its name
+int count_objects(census* result, object_hash* hashes, uint64_t num_objects){
+    qsort(hashes, num_objects, sizeof(object_hash), compare_object_hashes);
+    result->entries = malloc((num_objects ? num_objects : 1) * sizeof(census_entry));
+    if(result->entries == NULL)
+        return OUT_OF_MEM;
+
+    int known_entry[sizeof(known_objects) / sizeof(known_objects[0])];
+    for(unsigned int k = 0; k < sizeof(known_objects) / sizeof(known_objects[0]); ++k)
+        known_entry[k] = -1;
+
+    unsigned int num_entries = 0;
+    for(uint64_t i = 0; i < num_objects; ++i){
+        //Equal hashes are next to each other after sorting
+        if(num_entries && result->entries[num_entries - 1].hash == hashes[i].hash){
+            ++result->entries[num_entries - 1].count;
+            continue;
+        }
+        census_entry entry = {.hash = hashes[i].hash, .cells = hashes[i].cells, .count = 1};
+        int known = name_object(&entry);
+        if(known >= 0 && known_entry[known] >= 0){
+            ++result->entries[known_entry[known]].count;
+            continue;
+        }
+        //Every phase of a known object counts towards the entry of its first phase
+        for(int k = 0; known >= 0 && known_objects[k].name != NULL; ++k){
+            if(strcmp(known_objects[k].name, entry.name) == 0)
+                known_entry[k] = num_entries;
+        }
+        result->entries[num_entries++] = entry;
+    }
+    result->num_entries = num_entries;
+    qsort(result->entries, num_entries, sizeof(census_entry), compare_entries);
+    return NO_ERR;
+}
+
+//Labels the whole field from scratch every time rather than updating the last census.  Union-find
+//can join objects but not split them again when a cell between them dies, and knowing which
+//objects changed would take per-cell bookkeeping on the stepping thread, which is what the worker
+//is there to avoid.  The work is proportional to the runs of live cells, with empty words skipped
+int take_census(field_data* field, census* result){
+    pthread_once(&known_objects_once, hash_known_objects);
+    result->entries = NULL;
+    result->num_entries = 0;
+    result->num_objects = 0;
+
+    run_labels labels = {0};
+    size_t* row_start = malloc(((size_t) field->size_y + 1) * sizeof(size_t));
+    if(row_start == NULL)
+        return OUT_OF_MEM;
+    if(find_runs(field, &labels, row_start) != NO_ERR){
+        free(labels.runs);
+        free(row_start);
+        return OUT_OF_MEM;
+    }
+
+    size_t num_runs = labels.num_runs;
+    labels.parent = malloc((num_runs + 1) * sizeof(size_t));
+    labels.size = malloc((num_runs + 1) * sizeof(uint64_t));
+    labels.shift_x = malloc((num_runs + 1) * sizeof(int64_t));
+    labels.shift_y = malloc((num_runs + 1) * sizeof(int64_t));
+    labels.wraps = malloc((num_runs + 1) * sizeof(bool));
+    size_t* order = malloc((num_runs + 1) * sizeof(size_t));
+    size_t* first_run = malloc((num_runs + 2) * sizeof(size_t));
+    object_hash* hashes = malloc((num_runs + 1) * sizeof(object_hash));
+    int status = (labels.parent && labels.size && labels.shift_x && labels.shift_y && labels.wraps && order && first_run && hashes) ? NO_ERR : OUT_OF_MEM;
+
+    cell_point* cells = NULL;
+    cell_point* scratch = NULL;
+    if(status == NO_ERR){
+        for(size_t i = 0; i < num_runs; ++i){
+            labels.parent[i] = i;
+            labels.size[i] = 1;
+            labels.shift_x[i] = 0;
+            labels.shift_y[i] = 0;
+            labels.wraps[i] = false;
+        }
+
+        for(unsigned int y = 0; y < field->size_y; ++y){
+            //A run that touches both ends of a wrapping row is its own neighbour
+            size_t first = row_start[y], last = row_start[y + 1];
+            if(field->edge_wrap && first < last && labels.runs[first].x_start == 0 && labels.runs[last - 1].x_end == field->size_x - 1)
+                join_runs(&labels, last - 1, first, field->size_x, 0);
+            if(y + 1 < field->size_y)
+                join_rows(field, &labels, row_start, y, y + 1, 0);
+        }
+        if(field->edge_wrap)
+            join_rows(field, &labels, row_start, field->size_y - 1, 0, field->size_y);
+
+        //Group the runs of every object together.  first_run doubles as the object index of each root
+        uint64_t num_objects = 0;
+        for(size_t i = 0; i < num_runs; ++i){
+            if(labels.parent[i] == i)
+                first_run[i] = num_objects++;
+        }
+        for(uint64_t o = 0; o <= num_objects; ++o)
+            hashes[o].cells = 0;
+        int64_t shift_x, shift_y;
+        for(size_t i = 0; i < num_runs; ++i){
+            size_t root = find_label(&labels, i, &shift_x, &shift_y);
+            hashes[first_run[root]].cells += 1;
+        }
+        //hashes[o].cells briefly holds the number of runs in each object, to bucket them
+        size_t offset = 0;
+        for(uint64_t o = 0; o < num_objects; ++o){
+            size_t runs_in_object = hashes[o].cells;
+            hashes[o].cells = offset;
+            offset += runs_in_object;
+        }
+        for(size_t i = 0; i < num_runs; ++i){
+            size_t root = labels.parent[i];
+            order[hashes[first_run[root]].cells++] = i;
+        }
+
+        //Now hashes[o].cells is where the runs of the next object start
+        size_t start = 0;
+        uint64_t cell_capacity = 0;
+        for(uint64_t o = 0; o < num_objects && status == NO_ERR; ++o){
+            size_t end = hashes[o].cells;
+            size_t root = labels.parent[order[start]];
+            uint64_t num_cells = 0;
+            for(size_t r = start; r < end; ++r)
+                num_cells += labels.runs[order[r]].x_end - labels.runs[order[r]].x_start + 1;
+
+            if(labels.wraps[root]){
+                hashes[o] = (object_hash) {WRAPPING_HASH, num_cells};
+                start = end;
+                continue;
+            }
+            if(num_cells > cell_capacity){
+                cell_capacity = num_cells;
+                free(cells);
+                free(scratch);
+                cells = malloc(cell_capacity * sizeof(cell_point));
+                scratch = malloc(cell_capacity * sizeof(cell_point));
+                if(cells == NULL || scratch == NULL){
+                    status = OUT_OF_MEM;
+                    break;
+                }
+            }
+
+            uint64_t c = 0;
+            for(size_t r = start; r < end; ++r){
+                cell_run* run = &labels.runs[order[r]];
+                find_label(&labels, order[r], &shift_x, &shift_y);
+                for(unsigned int x = run->x_start; x <= run->x_end; ++x)
+                    cells[c++] = (cell_point) {(int64_t) x + shift_x, (int64_t) run->y + shift_y};
+            }
+            hashes[o] = (object_hash) {canonical_hash(cells, scratch, num_cells), num_cells};
+            start = end;
+        }
+
+        if(status == NO_ERR){
+            result->num_objects = num_objects;
+            status = count_objects(result, hashes, num_objects);
+        }
+    }
+
+    free(cells);
+    free(scratch);
+    free(hashes);
+    free(first_run);
+    free(order);
+    free(labels.wraps);
+    free(labels.shift_y);
+    free(labels.shift_x);
+    free(labels.size);
+    free(labels.parent);
+    free(labels.runs);
+    free(row_start);
+    return status;
+}
+
+void free_census(census* result){
+    free(result->entries);
+    result->entries = NULL;
+    result->num_entries = 0;
+}
+
+void describe_census(census* result, char* text, size_t len){
+    int written = snprintf(text, len, "%" PRIu64 " objects", result->num_objects);
+    for(unsigned int e = 0; e < result->num_entries && e < CENSUS_SUMMARY_ENTRIES; ++e){
+        if(written < 0 || (size_t) written >= len)
+            return;
+        written += snprintf(text + written, len - written, "%s %" PRIu64 " %s", e ? "," : ":", result->entries[e].count, result->entries[e].name);
+    }
+}
+
+//Leaves the pages of words that stay dead untouched, just like the row kernels
+void copy_changed_words(uint32_t* dest, uint32_t* src, uint64_t num_words){
+    for(uint64_t i = 0; i < num_words; ++i){
+        if(dest[i] != src[i])
+            dest[i] = src[i];
+    }
+}
+
+void* census_worker_main(void* arg){
+    census_worker* worker = arg;
+    pthread_mutex_lock(&worker->lock);
+    while(true){
+        while(!worker->busy && !worker->quit)
+            pthread_cond_wait(&worker->wake, &worker->lock);
+        if(worker->quit)
+            break;
+
+        //The snapshot belongs to this thread until busy is cleared
+        pthread_mutex_unlock(&worker->lock);
+        census result;
+        int status = take_census(&worker->snapshot, &result);
+        result.generation = worker->snapshot_generation;
+        pthread_mutex_lock(&worker->lock);
+
+        if(status == NO_ERR){
+            free_census(&worker->latest);
+            worker->latest = result;
+        }
+        worker->busy = false;
+    }
+    pthread_mutex_unlock(&worker->lock);
+    return NULL;
+}
+
+int init_census_worker(census_worker* worker, field_data* field){
+    int status = init_field(&worker->snapshot, field->size_x, field->size_y, 0, field->edge_wrap, NULL);
+    if(status != NO_ERR)
+        return status;
+    worker->snapshot.rules = field->rules;
+    worker->snapshot.row_origin = field->row_origin;
+    worker->busy = false;
+    worker->quit = false;
+    worker->latest = (census) {NULL, 0, 0, 0};
+    pthread_mutex_init(&worker->lock, NULL);
+    pthread_cond_init(&worker->wake, NULL);
+    if(pthread_create(&worker->thread, NULL, census_worker_main, worker) != 0){
+        pthread_cond_destroy(&worker->wake);
+        pthread_mutex_destroy(&worker->lock);
+        free_field(&worker->snapshot);
+        return CENSUS_INIT_FAIL;
+    }
+    return NO_ERR;
+}
+
+//Hands the worker a copy of the field, unless it is still busy with the last one.  Only this
+//thread sets busy, so once it is clear the snapshot can be filled in without holding the lock
+bool request_census(census_worker* worker, field_data* field, unsigned int generation){
+    pthread_mutex_lock(&worker->lock);
+    bool idle = !worker->busy;
+    pthread_mutex_unlock(&worker->lock);
+    if(!idle)
+        return false;
+
+    copy_changed_words(worker->snapshot.buffer_r->bitmap, field->buffer_r->bitmap, field->buffer_r->num_words);
+    worker->snapshot_generation = generation;
+    pthread_mutex_lock(&worker->lock);
+    worker->busy = true;
+    pthread_cond_signal(&worker->wake);
+    pthread_mutex_unlock(&worker->lock);
+    return true;
+}
+
+void describe_latest_census(census_worker* worker, char* text, size_t len){
+    pthread_mutex_lock(&worker->lock);
+    if(worker->latest.entries)
+        describe_census(&worker->latest, text, len);
+    else
+        snprintf(text, len, "census pending");
+    pthread_mutex_unlock(&worker->lock);
+}
+
+void free_census_worker(census_worker* worker){
+    pthread_mutex_lock(&worker->lock);
+    worker->quit = true;
+    pthread_cond_signal(&worker->wake);
+    pthread_mutex_unlock(&worker->lock);
+    pthread_join(worker->thread, NULL);
+
+    pthread_cond_destroy(&worker->wake);
+    pthread_mutex_destroy(&worker->lock);
+    free_census(&worker->latest);
+    free_field(&worker->snapshot);
+}
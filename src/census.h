@@ -0,0 +1,49 @@
+#ifndef CENSUS_H
+#define CENSUS_H
+
+#include <pthread.h>
+
+#include "gamefield.h"
+
+#define CENSUS_NAME_LENGTH 48
+//How many of the most common objects a census summary lists
+#define CENSUS_SUMMARY_ENTRIES 6
+
+//All the objects of one shape, no matter where they are or which way they face
+typedef struct census_entry_t{
+    char name[CENSUS_NAME_LENGTH];
+    uint64_t hash;
+    uint64_t cells;
+    uint64_t count;
+} census_entry;
+
+//Entries are sorted from the most to the least common object
+typedef struct census_t{
+    census_entry* entries;
+    unsigned int num_entries;
+    uint64_t num_objects;
+    unsigned int generation;
+} census;
+
+//Takes censuses of copies of a field on its own thread, so the simulation never waits for one
+typedef struct census_worker_t{
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    field_data snapshot;
+    unsigned int snapshot_generation;
+    bool busy;
+    bool quit;
+    census latest;
+} census_worker;
+
+int take_census(field_data* field, census* result);
+void free_census(census* result);
+void describe_census(census* result, char* text, size_t len);
+
+int init_census_worker(census_worker* worker, field_data* field);
+bool request_census(census_worker* worker, field_data* field, unsigned int generation);
+void describe_latest_census(census_worker* worker, char* text, size_t len);
+void free_census_worker(census_worker* worker);
+
+#endif
@@ -12,7 +12,15 @@ enum errcode{
         FILE_TAG_UNSUPP,
         FILE_FORMAT_UNEXP,
         FILE_DUPE_ATTR,
+        FILE_WRITE_FAIL,
         RULE_PARSE_FAIL,
+        SHARD_INIT_FAIL,
+        EVENT_LOOP_FAIL,
+        CENSUS_INIT_FAIL,
+        BROADCAST_FAIL,
+        FRAME_FORMAT_FAIL,
+        PATTERN_NOT_FOUND,
+        RECORDING_FAIL,
 	OUT_OF_MEM
 };
 
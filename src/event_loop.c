@@ -0,0 +1,111 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+#include "event_loop.h"
+#include "errcode.h"
+
+#define MAX_EVENTS 16
+
+int add_to_epoll(int epoll_fd, int fd, uint32_t tag);
+
+int add_to_epoll(int epoll_fd, int fd, uint32_t tag){
+    struct epoll_event event = {.events = EPOLLIN, .data.u32 = tag};
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+}
+
+int init_event_loop(event_loop* loop, int input_fd, uint64_t tick_ns){
+    loop->tick_ns = tick_ns;
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    loop->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    //SIGWINCH has to be blocked so it is only ever delivered through the signalfd
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGWINCH);
+    sigprocmask(SIG_BLOCK, &signals, NULL);
+    loop->signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    if(loop->epoll_fd < 0 || loop->timer_fd < 0 || loop->signal_fd < 0
+       || add_to_epoll(loop->epoll_fd, loop->timer_fd, TICK_EVENT)
+       || add_to_epoll(loop->epoll_fd, input_fd, INPUT_EVENT)
+       || add_to_epoll(loop->epoll_fd, loop->signal_fd, RESIZE_EVENT)){
+        free_event_loop(loop);
+        return EVENT_LOOP_FAIL;
+    }
+    return NO_ERR;
+}
+
+void free_event_loop(event_loop* loop){
+    if(loop->epoll_fd >= 0)
+        close(loop->epoll_fd);
+    if(loop->timer_fd >= 0)
+        close(loop->timer_fd);
+    if(loop->signal_fd >= 0)
+        close(loop->signal_fd);
+    loop->epoll_fd = loop->timer_fd = loop->signal_fd = -1;
+}
+
+//Starts watching fd for the given epoll events, or changes which events it is watched for
+int watch_fd(event_loop* loop, int fd, uint32_t events, enum loop_event tag){
+    struct epoll_event event = {.events = events, .data.u32 = tag};
+    if(epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0)
+        return NO_ERR;
+    if(errno == EEXIST && epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, fd, &event) == 0)
+        return NO_ERR;
+    return EVENT_LOOP_FAIL;
+}
+
+void unwatch_fd(event_loop* loop, int fd){
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+void arm_ticks(event_loop* loop, bool armed){
+    //A periodic timer keeps an absolute schedule, so slow frames never push later ticks back
+    struct itimerspec spec = {{0, 0}, {0, 0}};
+    if(armed){
+        spec.it_interval.tv_sec = loop->tick_ns / (1000 * NS_PER_MS);
+        spec.it_interval.tv_nsec = loop->tick_ns % (1000 * NS_PER_MS);
+        spec.it_value = spec.it_interval;
+    }
+    timerfd_settime(loop->timer_fd, 0, &spec, NULL);
+}
+
+int wait_for_events(event_loop* loop, uint64_t* ticks){
+    struct epoll_event events[MAX_EVENTS];
+    int result = 0;
+    *ticks = 0;
+
+    int num_events = epoll_wait(loop->epoll_fd, events, MAX_EVENTS, -1);
+    if(num_events < 0)
+        return (errno == EINTR) ? 0 : -1;
+
+    for(int i = 0; i < num_events; ++i){
+        uint32_t tag = events[i].data.u32;
+        if(tag == TICK_EVENT){
+            //Reading the timer tells us how many ticks have passed since we last read it
+            uint64_t expirations;
+            if(read(loop->timer_fd, &expirations, sizeof(expirations)) == sizeof(expirations))
+                *ticks += expirations;
+        }else if(tag == RESIZE_EVENT){
+            struct signalfd_siginfo info;
+            while(read(loop->signal_fd, &info, sizeof(info)) == sizeof(info));
+        }
+        result |= tag;
+    }
+    if(*ticks == 0)
+        result &= ~TICK_EVENT;
+    return result;
+}
+
+uint64_t monotonic_ns(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000 * NS_PER_MS + now.tv_nsec;
+}
@@ -0,0 +1,34 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define NS_PER_MS 1000000ULL
+#define NS_PER_US 1000ULL
+
+enum loop_event{
+    TICK_EVENT = 0b001,
+    INPUT_EVENT = 0b010,
+    RESIZE_EVENT = 0b100,
+    SOCKET_EVENT = 0b1000
+};
+
+//Waits on the terminal input, a timerfd that fires once per simulation tick, SIGWINCH and any
+//sockets that are added with watch_fd
+typedef struct event_loop_t{
+    int epoll_fd;
+    int timer_fd;
+    int signal_fd;
+    uint64_t tick_ns;
+} event_loop;
+
+int init_event_loop(event_loop* loop, int input_fd, uint64_t tick_ns);
+void free_event_loop(event_loop* loop);
+void arm_ticks(event_loop* loop, bool armed);
+int watch_fd(event_loop* loop, int fd, uint32_t events, enum loop_event tag);
+void unwatch_fd(event_loop* loop, int fd);
+int wait_for_events(event_loop* loop, uint64_t* ticks);
+uint64_t monotonic_ns(void);
+
+#endif
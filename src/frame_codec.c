@@ -0,0 +1,190 @@
+#include <string.h>
+
+#include "frame_codec.h"
+#include "errcode.h"
+
+//A frame is the XOR of two generations, stored as pairs of (number of unchanged words, number of
+//changed words) followed by the changed words themselves.  A field that did not change at all
+//encodes to a couple of bytes
+
+//Changed words are XORed into a small buffer on the stack before they go to the sink
+#define SINK_WORDS 256
+//The block compressor remembers where it last saw each of this many hashes of 4 bytes
+#define BLOCK_HASH_BITS 12
+
+uint8_t* write_varint(uint8_t* out, uint64_t value);
+uint8_t* read_varint(uint8_t* in, uint8_t* end, uint64_t* value);
+void copy_to_buffer(void* context, const void* bytes, size_t len);
+
+uint8_t* write_varint(uint8_t* out, uint64_t value){
+    while(value >= 0x80){
+        *out++ = (uint8_t) value | 0x80;
+        value >>= 7;
+    }
+    *out++ = (uint8_t) value;
+    return out;
+}
+
+uint8_t* read_varint(uint8_t* in, uint8_t* end, uint64_t* value){
+    *value = 0;
+    for(unsigned int shift = 0; in < end && shift < 7 * MAX_VARINT_BYTES; shift += 7){
+        uint8_t byte = *in++;
+        *value |= (uint64_t) (byte & 0x7F) << shift;
+        if(!(byte & 0x80))
+            return in;
+    }
+    return NULL;
+}
+
+size_t max_encoded_len(uint64_t num_words){
+    //A varint is never longer than the count it holds, so a pair takes at most one byte per
+    //unchanged word and five per changed word.  Only the first pair can have no unchanged words,
+    //and only the last one no changed words
+    return 5 * num_words + 2;
+}
+
+void copy_to_buffer(void* context, const void* bytes, size_t len){
+    uint8_t** out = context;
+    memcpy(*out, bytes, len);
+    *out += len;
+}
+
+//Encodes frame against previous, or as a key frame when previous is NULL
+size_t encode_frame(uint32_t* frame, uint32_t* previous, uint64_t num_words, uint8_t* out){
+    return encode_frame_to(frame, previous, num_words, copy_to_buffer, &out);
+}
+
+//Hands the encoded frame to sink piece by piece and returns its length.  Without a sink it only
+//works out how long the frame is
+uint64_t encode_frame_to(uint32_t* frame, uint32_t* previous, uint64_t num_words, frame_sink sink, void* context){
+    uint64_t len = 0;
+    uint64_t word = 0;
+    while(word < num_words){
+        uint64_t unchanged = word;
+        while(unchanged < num_words && frame[unchanged] == (previous ? previous[unchanged] : 0))
+            ++unchanged;
+        uint64_t changed = unchanged;
+        while(changed < num_words && frame[changed] != (previous ? previous[changed] : 0))
+            ++changed;
+
+        uint8_t counts[2 * MAX_VARINT_BYTES];
+        uint8_t* counts_end = write_varint(write_varint(counts, unchanged - word), changed - unchanged);
+        len += (counts_end - counts) + (changed - unchanged) * sizeof(uint32_t);
+        if(sink){
+            sink(context, counts, counts_end - counts);
+            uint32_t deltas[SINK_WORDS];
+            for(uint64_t i = unchanged; i < changed; i += SINK_WORDS){
+                unsigned int num_deltas = (changed - i < SINK_WORDS) ? changed - i : SINK_WORDS;
+                for(unsigned int d = 0; d < num_deltas; ++d)
+                    deltas[d] = frame[i + d] ^ (previous ? previous[i + d] : 0);
+                sink(context, deltas, num_deltas * sizeof(uint32_t));
+            }
+        }
+        word = changed;
+    }
+    return len;
+}
+
+//Applies an encoded frame to the one before it, which is thrown away first for a key frame
+int decode_frame(uint8_t* in, size_t len, uint32_t* frame, uint64_t num_words, bool key){
+    uint8_t* end = in + len;
+    if(key)
+        memset(frame, 0, num_words * sizeof(uint32_t));
+
+    uint64_t word = 0;
+    while(in < end){
+        uint64_t unchanged, changed;
+        in = read_varint(in, end, &unchanged);
+        if(in == NULL)
+            return FRAME_FORMAT_FAIL;
+        in = read_varint(in, end, &changed);
+        if(in == NULL || unchanged > num_words - word || changed > num_words - word - unchanged
+           || changed > (size_t) (end - in) / sizeof(uint32_t))
+            return FRAME_FORMAT_FAIL;
+
+        word += unchanged;
+        for(uint64_t i = 0; i < changed; ++i, ++word){
+            uint32_t delta;
+            memcpy(&delta, in, sizeof(delta));
+            in += sizeof(delta);
+            frame[word] ^= delta;
+        }
+    }
+    return NO_ERR;
+}
+
+//Compresses a block as sequences of (number of literal bytes, the literal bytes, how far back
+//the repeat that follows starts, its length past BLOCK_MIN_MATCH).  The last sequence is only
+//literals.  Returns 0 if the result would not fit in capacity, in which case the block is better
+//stored as it is
+size_t compress_block(uint8_t* in, size_t len, uint8_t* out, size_t capacity){
+    //Positions are kept one higher, so 0 means nothing was seen yet
+    uint32_t last_seen[1 << BLOCK_HASH_BITS] = {0};
+    uint8_t* start = out;
+    uint8_t* end = out + capacity;
+    size_t pos = 0, literal_start = 0;
+
+    while(pos + BLOCK_MIN_MATCH <= len){
+        uint32_t bytes;
+        memcpy(&bytes, in + pos, sizeof(bytes));
+        uint32_t slot = (bytes * 2654435761U) >> (32 - BLOCK_HASH_BITS);
+        size_t candidate = last_seen[slot];
+        last_seen[slot] = pos + 1;
+        if(candidate == 0 || memcmp(in + candidate - 1, in + pos, BLOCK_MIN_MATCH) != 0){
+            ++pos;
+            continue;
+        }
+
+        size_t from = candidate - 1, match = BLOCK_MIN_MATCH;
+        while(pos + match < len && in[from + match] == in[pos + match])
+            ++match;
+        size_t literals = pos - literal_start;
+        if((size_t) (end - out) < 3 * MAX_VARINT_BYTES + literals)
+            return 0;
+        out = write_varint(out, literals);
+        memcpy(out, in + literal_start, literals);
+        out += literals;
+        out = write_varint(out, pos - from);
+        out = write_varint(out, match - BLOCK_MIN_MATCH);
+        pos += match;
+        literal_start = pos;
+    }
+
+    size_t literals = len - literal_start;
+    if((size_t) (end - out) < MAX_VARINT_BYTES + literals)
+        return 0;
+    out = write_varint(out, literals);
+    memcpy(out, in + literal_start, literals);
+    return out + literals - start;
+}
+
+//Fails unless the block decompresses to exactly out_len bytes
+int decompress_block(uint8_t* in, size_t len, uint8_t* out, size_t out_len){
+    uint8_t* end = in + len;
+    size_t produced = 0;
+    while(true){
+        uint64_t literals;
+        in = read_varint(in, end, &literals);
+        if(in == NULL || literals > (size_t) (end - in) || literals > out_len - produced)
+            return FRAME_FORMAT_FAIL;
+        memcpy(out + produced, in, literals);
+        in += literals;
+        produced += literals;
+        if(in == end)
+            break;
+
+        uint64_t distance, match;
+        in = read_varint(in, end, &distance);
+        if(in == NULL)
+            return FRAME_FORMAT_FAIL;
+        in = read_varint(in, end, &match);
+        if(in == NULL || distance == 0 || distance > produced || out_len - produced < BLOCK_MIN_MATCH
+           || match > out_len - produced - BLOCK_MIN_MATCH)
+            return FRAME_FORMAT_FAIL;
+        //Byte by byte, since a repeat can overlap the bytes it is producing
+        match += BLOCK_MIN_MATCH;
+        for(uint64_t i = 0; i < match; ++i, ++produced)
+            out[produced] = out[produced - distance];
+    }
+    return (produced == out_len) ? NO_ERR : FRAME_FORMAT_FAIL;
+}
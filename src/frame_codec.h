@@ -0,0 +1,38 @@
+#ifndef FRAME_CODEC_H
+#define FRAME_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FRAME_MAGIC 0x4546494CU
+//A key frame stands on its own, any other frame only holds what changed since the one before it
+#define FRAME_KEY 0b1
+//The field uses a hexagonal neighbourhood, so viewers draw it with offset rows
+#define FRAME_HEXAGONAL 0b10
+//Longest a 64 bit varint can get
+#define MAX_VARINT_BYTES 10
+//Shortest repeat the block compressor refers back to instead of storing it again
+#define BLOCK_MIN_MATCH 4
+
+//Written in front of every encoded frame
+typedef struct frame_header_t{
+    uint32_t magic;
+    uint32_t flags;
+    uint32_t width;
+    uint32_t height;
+    uint64_t generation;
+    uint64_t payload_len;
+} frame_header;
+
+//Takes an encoded frame a piece at a time, for output that is not one contiguous buffer
+typedef void (*frame_sink)(void* context, const void* bytes, size_t len);
+
+size_t max_encoded_len(uint64_t num_words);
+size_t encode_frame(uint32_t* frame, uint32_t* previous, uint64_t num_words, uint8_t* out);
+uint64_t encode_frame_to(uint32_t* frame, uint32_t* previous, uint64_t num_words, frame_sink sink, void* context);
+int decode_frame(uint8_t* in, size_t len, uint32_t* frame, uint64_t num_words, bool key);
+size_t compress_block(uint8_t* in, size_t len, uint8_t* out, size_t capacity);
+int decompress_block(uint8_t* in, size_t len, uint8_t* out, size_t out_len);
+
+#endif
@@ -2,6 +2,7 @@
 #include <ctype.h>
 
 #include "gamefield.h"
+#include "kernels.h"
 #include "errcode.h"
 
 enum cell_status{
@@ -10,141 +11,740 @@ enum cell_status{
     INVALID
 };
 
+//The per word arrays of a field's tile scratch
+enum tile_scratch_array{
+    TOP_CHANGES = 0,
+    MIDDLE_CHANGES,
+    BOTTOM_CHANGES,
+    TILE_POPULATION,
+    TILE_BITS,
+    TILE_LIVE_ROWS,
+    TILE_MODE,
+    TILE_CAPTURED,
+    TILE_REPEATING,
+    TILE_SCRATCH_ARRAYS
+};
+
+//What a step does with each tile of a band
+enum tile_mode{
+    //Left as buffer_w holds it, since it repeats every two generations
+    TILE_FROZEN = 0,
+    //Copied back from its cycle, since it repeats every three
+    TILE_REPLAYED,
+    TILE_STEPPED,
+    //Stepped, and flagged by what changed in it
+    TILE_TRACKED
+};
+
 const char LIVE_CELL = '*';
 const char DEAD_CELL = '.';
+//Life 1.05 lines may be up to 80 characters, so saved patterns are split into blocks narrower than that
+const unsigned int SAVE_BLOCK_WIDTH = 64;
+//Every this many full steps, the changes of every tile are tracked, so that tiles whose edges
+//have gone quiet are found even if their population never repeats
+const unsigned int TRACK_INTERVAL = 8;
+//A tile that stays dead repeats itself with every period
+const uint8_t DEAD_TILE_FLAGS = TILE_CYCLED | TILE_EDGES_CYCLED | TILE_CYCLED_3 | TILE_EDGES_CYCLED_3;
 
 char random_word(int seed_rate);
-unsigned int num_words_for_field(unsigned int field_len);
-void swap_buffers(field_data* field);
-int count_neighbours(field_data* field, unsigned int offset);
-void set_cell(field_data* field, unsigned int offset, bool val);
-void toggle_cell(field_data* field, unsigned int offset);
-unsigned int relative_offset(field_data* field, unsigned int offset, int rel_x, int rel_y);
-unsigned int next_newline_from(field_data* field, unsigned int offset);
+uint64_t cell_bit_index(field_data* field, uint64_t offset);
+uint32_t* neighbour_row(field_data* field, unsigned int y, int rel_y);
+int count_neighbours(field_data* field, uint64_t offset);
+void set_cell(field_data* field, uint64_t offset, bool val);
+void toggle_cell(field_data* field, uint64_t offset);
+uint64_t relative_offset(field_data* field, uint64_t offset, int rel_x, int rel_y);
 bool has_prefix(char* string, const char* prefix);
 bool is_line_end(char* string);
 enum cell_status parse_field_cell(char c);
-unsigned int pattern_next_line(field_data* field, unsigned int pattern_cursor, unsigned int newline_offset);
-bool get_cell_relative_offset(field_data* field, unsigned int offset, int rel_x, int rel_y);
+uint64_t pattern_next_line(field_data* field, uint64_t pattern_cursor, unsigned int newline_offset);
+bool get_cell_relative_offset(field_data* field, uint64_t offset, int rel_x, int rel_y);
+void empty_stats(field_data* field, field_stats* stats);
+uint32_t count_bits(uint32_t word);
+uint32_t* tile_array(field_data* field, enum tile_scratch_array array);
+void measure_words(field_data* field, uint32_t* row, unsigned int first_word, unsigned int end_word, unsigned int band_row);
+void store_tile(field_data* field, tile_stats* tile, unsigned int word);
+void add_tile_stats(field_stats* stats, tile_stats* tile, unsigned int band, unsigned int word);
+void track_field(field_data* field);
+bool tile_settling(field_data* field, unsigned int band, unsigned int word);
+bool tile_may_cycle(tile_stats* tile);
+tile_stats* band_tiles(field_data* field, int64_t band, uint8_t* flags);
+void find_repeating_tiles(field_data* field, unsigned int band);
+void find_captured_tiles(field_data* field, unsigned int band);
+uint32_t tile_edge_mask(field_data* field, unsigned int word);
+uint8_t cycle_flags(field_data* field, unsigned int word, uint32_t changed, uint32_t edges_changed, unsigned int period);
+unsigned int band_rows(field_data* field, unsigned int band);
+uint8_t replay_tile(field_data* field, unsigned int band, unsigned int word, tile_stats* tile);
+uint8_t capture_tile(field_data* field, unsigned int band, unsigned int word, tile_stats* tile);
+void step_band(field_data* field, row_kernel kernel, unsigned int band, unsigned int clean_steps, bool capture);
+void step_range(field_data* field, unsigned int* first_row, unsigned int* last_row);
+void fit_hexagonal_torus(field_data* field);
+
+//Every field created from now on gets its memory mapped this way
+enum page_mode field_page_mode = NORMAL_PAGES;
+
+//Where the neighbours of a cell are, as {x, y} offsets
+const int MOORE_NEIGHBOURS[][2] = {{-1, -1}, {0, -1}, {1, -1}, {-1, 0}, {1, 0}, {-1, 1}, {0, 1}, {1, 1}};
+const int VON_NEUMANN_NEIGHBOURS[][2] = {{0, -1}, {-1, 0}, {1, 0}, {0, 1}};
+//Odd rows sit half a cell to the right, so the overlapping cells above and below are on the left
+//of an even row's cell and on the right of an odd row's cell
+const int HEXAGONAL_EVEN_NEIGHBOURS[][2] = {{-1, -1}, {0, -1}, {-1, 0}, {1, 0}, {-1, 1}, {0, 1}};
+const int HEXAGONAL_ODD_NEIGHBOURS[][2] = {{0, -1}, {1, -1}, {-1, 0}, {1, 0}, {0, 1}, {1, 1}};
+
+int count_neighbours(field_data* field, uint64_t offset){
+    const int (*neighbours)[2] = MOORE_NEIGHBOURS;
+    if(field->rules.neighbourhood == VON_NEUMANN)
+        neighbours = VON_NEUMANN_NEIGHBOURS;
+    else if(field->rules.neighbourhood == HEXAGONAL)
+        neighbours = is_odd_row(field, offset / field->size_x) ? HEXAGONAL_ODD_NEIGHBOURS : HEXAGONAL_EVEN_NEIGHBOURS;
 
-int count_neighbours(field_data* field, unsigned int offset){
     int count = 0;
-    for(int x_offset = -1; x_offset <= 1; ++x_offset){
-        for(int y_offset = -1; y_offset <= 1; ++y_offset){
-            //A cell is not its own neighbour
-            if(x_offset == 0 && y_offset == 0)
-                continue;
-            if(get_cell_relative_offset(field, offset, x_offset, y_offset))
-               ++count;
-        }
+    for(int i = 0; i < neighbourhood_size(field->rules.neighbourhood); ++i){
+        if(get_cell_relative_offset(field, offset, neighbours[i][0], neighbours[i][1]))
+           ++count;
     }
     return count;
 }
 
-bool get_cell_relative_offset(field_data* field, unsigned int offset, int rel_x, int rel_y){
+bool get_cell_relative_offset(field_data* field, uint64_t offset, int rel_x, int rel_y){
 
-    int new_x = rel_x + (offset % field->size_x);
+    int64_t new_x = rel_x + (int64_t) (offset % field->size_x);
     if(new_x < 0){
         if(!field->edge_wrap)
             return false;
         new_x += field->size_x;
-    }else if((unsigned int) new_x >= field->size_x){
+    }else if((uint64_t) new_x >= field->size_x){
         if(!field->edge_wrap)
             return false;
         new_x %= field->size_x;
     }
 
-    int new_y = rel_y + (offset / field->size_x);
+    int64_t new_y = rel_y + (int64_t) (offset / field->size_x);
     if(new_y < 0){
         if(!field->edge_wrap)
             return false;
         new_y += field->size_y;
-    }else if((unsigned int) new_y >= field->size_y){
+    }else if((uint64_t) new_y >= field->size_y){
         if(!field->edge_wrap)
             return false;
         new_y %= field->size_y;
     }
 
-    unsigned int offset_new = (new_y * field->size_x) + new_x;
+    uint64_t offset_new = ((uint64_t) new_y * field->size_x) + new_x;
 
     return get_cell(field, offset_new);
 }
 
-unsigned int relative_offset(field_data* field, unsigned int offset, int rel_x, int rel_y){
-    int x_offset = rel_x;
-    int y_offset = field->size_x * rel_y;
-    int total_offset = x_offset + y_offset;
-    return (unsigned int) (offset + total_offset);
+uint64_t relative_offset(field_data* field, uint64_t offset, int rel_x, int rel_y){
+    int64_t x_offset = rel_x;
+    int64_t y_offset = (int64_t) field->size_x * rel_y;
+    int64_t total_offset = x_offset + y_offset;
+    return (uint64_t) (offset + total_offset);
 }
 
-unsigned int pattern_next_line(field_data* field, unsigned int pattern_cursor, unsigned int newline_offset){
+uint64_t pattern_next_line(field_data* field, uint64_t pattern_cursor, unsigned int newline_offset){
     unsigned int offset_to_remove = (pattern_cursor % field->size_x);
     return (pattern_cursor + field->size_x - offset_to_remove + newline_offset);
 }
 
-void update_and_swap_fields(field_data* field){
-    for(unsigned int offset = 0; offset < field->field_len; ++offset){
+void update_rows_per_cell(field_data* field, unsigned int first_row, unsigned int last_row){
+    invalidate_field_stats(field);
+    uint64_t end = (uint64_t) (last_row + 1) * field->size_x;
+    for(uint64_t offset = (uint64_t) first_row * field->size_x; offset < end; ++offset){
         unsigned int neigh = count_neighbours(field, offset);
         bool state = get_cell(field, offset);
         bool nextState = next_cell_state(&field->rules, state, neigh);
         set_cell(field, offset, nextState);
     }
+}
+
+uint32_t* neighbour_row(field_data* field, unsigned int y, int rel_y){
+    int new_y = (int) y + rel_y;
+    if(new_y < 0 || (unsigned int) new_y >= field->size_y){
+        if(!field->edge_wrap)
+            return NULL;
+        new_y = (new_y + field->size_y) % field->size_y;
+    }
+    return field_row(field, field->buffer_r, new_y);
+}
+
+void update_rows(field_data* field, unsigned int first_row, unsigned int last_row){
+    invalidate_field_stats(field);
+    //Rules with a specialized kernel use it, anything else goes through the generic word kernel
+    row_kernel kernel = find_rule_kernel(&field->rules);
+    for(unsigned int y = first_row; y <= last_row; ++y){
+        step_row(kernel, &field->rules, neighbour_row(field, y, -1), field_row(field, field->buffer_r, y), neighbour_row(field, y, 1),
+                 field_row(field, field->buffer_w, y), 0, field->row_words, field->row_words, field->size_x, field->edge_wrap, is_odd_row(field, y), NULL);
+    }
+}
+
+//Whether a tile's changes are worth tracking: a tile of a band that was skipped is all dead, and
+//one whose population was the same as two generations before, twice in a row, or whose edges
+//were cycled, may well freeze.  Tiles of a soup that is still churning are not tracked
+bool tile_settling(field_data* field, unsigned int band, unsigned int word){
+    if(field->band_skips_r[band])
+        return true;
+    tile_stats* tile = &field->tiles_r[band * field->row_words + word];
+    return (tile->same_as_2 & 3) == 3 || (tile->flags & TILE_EDGES_CYCLED);
+}
+
+//Whether a tile has had the same population as three generations before, twice in a row, but
+//not the same as two generations before, and was not cycled.  Only such tiles might repeat
+//themselves every three generations but not every two.  Tiles whose changes were not tracked are
+//never cycled, so a still one is told apart by its population
+bool tile_may_cycle(tile_stats* tile){
+    return (tile->same_as_3 & 3) == 3 && (tile->same_as_2 & 3) != 3 && !(tile->flags & TILE_CYCLED);
+}
+
+//The tiles of buffer_r in a band, or NULL along with the flags each of its tiles counts as having.
+//Past a border that does not wrap every cell stays dead.  So do the cells of a band that the last
+//steps skipped, as a skipped band was dead in the generation before the step as well, and in the
+//one before that if it was skipped twice
+tile_stats* band_tiles(field_data* field, int64_t band, uint8_t* flags){
+    *flags = DEAD_TILE_FLAGS;
+    if(band < 0 || band >= field->num_bands){
+        if(!field->edge_wrap)
+            return NULL;
+        band = (band + field->num_bands) % field->num_bands;
+    }
+    if(field->band_skips_r[band] == 1)
+        *flags = TILE_CYCLED | TILE_EDGES_CYCLED;
+    return field->band_skips_r[band] ? NULL : field->tiles_r + (size_t) band * field->row_words;
+}
+
+//Flags the tiles of a band that repeat themselves, with TILE_CYCLED for a period of 2 and
+//TILE_CYCLED_3 for a period of 3.  A tile that was cycled, and whose neighbours all had cycled
+//edges, sees the same cells as it did period generations ago.  So its next generation is the one
+//it had period - 1 generations ago, which buffer_w already holds for a period of 2, and its cycle
+//holds for a period of 3
+void find_repeating_tiles(field_data* field, unsigned int band){
+    unsigned int words = field->row_words;
+    uint32_t* repeating = tile_array(field, TILE_REPEATING);
+    uint8_t above_flags, flags, below_flags;
+    tile_stats* above = band_tiles(field, (int64_t) band - 1, &above_flags);
+    tile_stats* tiles = band_tiles(field, band, &flags);
+    tile_stats* below = band_tiles(field, (int64_t) band + 1, &below_flags);
+    for(unsigned int word = 0; word < words; ++word)
+        repeating[word] = (above ? above[word].flags : above_flags) & (tiles ? tiles[word].flags : flags) & (below ? below[word].flags : below_flags);
+
+    //A cycled tile has cycled edges too, so its own column of three can be checked with the columns
+    //on either side of it
+    uint32_t first = repeating[0];
+    uint32_t previous = field->edge_wrap ? repeating[words - 1] : DEAD_TILE_FLAGS;
+    for(unsigned int word = 0; word < words; ++word){
+        uint32_t current = repeating[word];
+        uint32_t next = (word + 1 < words) ? repeating[word + 1] : field->edge_wrap ? first : DEAD_TILE_FLAGS;
+        uint32_t edges = previous & current & next;
+        uint8_t own = tiles ? tiles[word].flags : flags;
+        repeating[word] = ((own & TILE_CYCLED) && (edges & TILE_EDGES_CYCLED) ? TILE_CYCLED : 0) |
+                          ((own & TILE_CYCLED_3) && (edges & TILE_EDGES_CYCLED_3) ? TILE_CYCLED_3 : 0);
+        previous = current;
+    }
+}
+
+//Flags the tiles of a band whose generations are kept in their cycles: the ones that may cycle
+//every three generations, and their neighbours, whose edges they need to see repeat as well
+void find_captured_tiles(field_data* field, unsigned int band){
+    unsigned int words = field->row_words;
+    uint32_t* captured = tile_array(field, TILE_CAPTURED);
+    uint8_t flags;
+    tile_stats* above = band_tiles(field, (int64_t) band - 1, &flags);
+    tile_stats* tiles = band_tiles(field, band, &flags);
+    tile_stats* below = band_tiles(field, (int64_t) band + 1, &flags);
+    for(unsigned int word = 0; word < words; ++word)
+        captured[word] = (above && tile_may_cycle(&above[word])) | (tiles && tile_may_cycle(&tiles[word])) | (below && tile_may_cycle(&below[word]));
+
+    //Spread each column of three to the words on either side of it
+    uint32_t first = captured[0];
+    uint32_t previous = field->edge_wrap ? captured[words - 1] : 0;
+    for(unsigned int word = 0; word < words; ++word){
+        uint32_t current = captured[word];
+        uint32_t next = (word + 1 < words) ? captured[word + 1] : field->edge_wrap ? first : 0;
+        captured[word] = previous | current | next;
+        previous = current;
+    }
+}
+
+//The columns of a tile that its neighbours see.  The last word's last column is next to column
+//0 of a wrapping field
+uint32_t tile_edge_mask(field_data* field, unsigned int word){
+    uint32_t mask = 1U | (1U << (WORD_BITS - 1));
+    if(word == field->row_words - 1)
+        mask |= 1U << ((field->size_x - 1) % WORD_BITS);
+    return mask;
+}
+
+//The flags of a tile for a period, from the bits that changed in it since that many generations
+//ago, and the ones that changed in its first and last rows
+uint8_t cycle_flags(field_data* field, unsigned int word, uint32_t changed, uint32_t edges_changed, unsigned int period){
+    edges_changed |= changed & tile_edge_mask(field, word);
+    if(period == 2)
+        return (changed ? 0 : TILE_CYCLED) | (edges_changed ? 0 : TILE_EDGES_CYCLED);
+    return (changed ? 0 : TILE_CYCLED_3) | (edges_changed ? 0 : TILE_EDGES_CYCLED_3);
+}
+
+unsigned int band_rows(field_data* field, unsigned int band){
+    unsigned int top = band * TILE_ROWS;
+    return (top + TILE_ROWS < field->size_y) ? TILE_ROWS : field->size_y - top;
+}
+
+uint32_t* tile_array(field_data* field, enum tile_scratch_array array){
+    return field->tile_scratch + (size_t) array * field->row_words;
+}
+
+//Copies the generation a tile had three steps ago from its cycle into buffer_w, along with its
+//stats.  Returns the flags for how it compares with the generation buffer_w held
+uint8_t replay_tile(field_data* field, unsigned int band, unsigned int word, tile_stats* tile){
+    tile_cycle* cycle = &field->cycles[(size_t) band * field->row_words + word];
+    unsigned int slot = field->full_steps % 3;
+    unsigned int top = band * TILE_ROWS, rows = band_rows(field, band);
+    uint32_t changed = 0, edges_changed = 0;
+    for(unsigned int row = 0; row < rows; ++row){
+        uint32_t changed_row = store_word(field_row(field, field->buffer_w, top + row) + word, cycle->rows[slot][row]);
+        changed |= changed_row;
+        if(row == 0 || row == rows - 1)
+            edges_changed |= changed_row;
+    }
+    *tile = cycle->stats[slot];
+    return cycle_flags(field, word, changed, edges_changed, 2);
+}
+
+//Keeps the generation this step wrote to a tile in its cycle, in place of the one from three
+//steps ago.  Returns the flags for how the two compare, once the cycle has that generation
+uint8_t capture_tile(field_data* field, unsigned int band, unsigned int word, tile_stats* tile){
+    tile_cycle* cycle = &field->cycles[(size_t) band * field->row_words + word];
+    unsigned int slot = field->full_steps % 3;
+    unsigned int top = band * TILE_ROWS, rows = band_rows(field, band);
+    uint32_t changed = 0, edges_changed = 0;
+    for(unsigned int row = 0; row < rows; ++row){
+        uint32_t cells = field_row(field, field->buffer_w, top + row)[word];
+        uint32_t changed_row = cycle->rows[slot][row] ^ cells;
+        cycle->rows[slot][row] = cells;
+        changed |= changed_row;
+        if(row == 0 || row == rows - 1)
+            edges_changed |= changed_row;
+    }
+    cycle->stats[slot] = *tile;
+
+    bool in_a_row = cycle->last_step + 1 == field->full_steps;
+    bool complete = in_a_row && cycle->captured >= 3;
+    cycle->captured = !in_a_row ? 1 : (cycle->captured < 3) ? cycle->captured + 1 : 3;
+    cycle->last_step = field->full_steps;
+    return complete ? cycle_flags(field, word, changed, edges_changed, 3) : 0;
+}
+
+//Steps the rows of one band into buffer_w.  Frozen tiles are left as they are and replayed ones
+//are copied from their cycles.  The others are measured, and flagged by what changed in them if
+//their changes are tracked
+void step_band(field_data* field, row_kernel kernel, unsigned int band, unsigned int clean_steps, bool capture){
+    unsigned int words = field->row_words;
+    unsigned int top = band * TILE_ROWS;
+    unsigned int bottom = top + band_rows(field, band) - 1;
+    tile_stats* tiles = field->tiles_w + (size_t) band * words;
+    uint32_t* mode = tile_array(field, TILE_MODE);
+
+    //Whatever its tiles say, a band the step before last skipped is all dead
+    if(field->band_skips_w[band])
+        memset(tiles, 0, words * sizeof(tile_stats));
+
+    //A frozen tile needs both generations it was compared with to have come from full steps, and
+    //a replayed one needs all three, plus the one its cycle was compared with.  Until the tiles
+    //have a history of their populations, every one is tracked
+    bool track_all = clean_steps < 3 || field->full_steps % TRACK_INTERVAL == 0;
+    bool any_stepped = false;
+    uint32_t* repeating = tile_array(field, TILE_REPEATING);
+    find_repeating_tiles(field, band);
+    for(unsigned int word = 0; word < words; ++word){
+        if(clean_steps >= 2 && (repeating[word] & TILE_CYCLED)){
+            mode[word] = TILE_FROZEN;
+        }else if(clean_steps >= 4 && !field->band_skips_r[band] && (repeating[word] & TILE_CYCLED_3)){
+            mode[word] = TILE_REPLAYED;
+        }else{
+            mode[word] = (track_all || tile_settling(field, band, word)) ? TILE_TRACKED : TILE_STEPPED;
+            any_stepped = true;
+        }
+    }
+    if(capture)
+        find_captured_tiles(field, band);
+    else
+        memset(tile_array(field, TILE_CAPTURED), 0, words * sizeof(uint32_t));
+
+    //Each run of stepped tiles is stepped in one go, as splitting it up costs more than tracking
+    //the changes of a few tiles that were not worth it.  So a run is tracked whole or not at all
+    unsigned int first_word = 0;
+    while(first_word < words){
+        unsigned int end_word = first_word;
+        bool tracked = false;
+        while(end_word < words && mode[end_word] >= TILE_STEPPED)
+            tracked |= mode[end_word++] == TILE_TRACKED;
+        for(unsigned int word = first_word; word < end_word; ++word)
+            mode[word] = tracked ? TILE_TRACKED : TILE_STEPPED;
+        first_word = end_word + 1;
+    }
+
+    if(any_stepped)
+        memset(field->tile_scratch, 0, (size_t) TILE_MODE * words * sizeof(uint32_t));
+    for(unsigned int y = top; y <= bottom && any_stepped; ++y){
+        uint32_t* changes = tile_array(field, (y == top) ? TOP_CHANGES : (y == bottom) ? BOTTOM_CHANGES : MIDDLE_CHANGES);
+        uint32_t* above = neighbour_row(field, y, -1);
+        uint32_t* row = field_row(field, field->buffer_r, y);
+        uint32_t* below = neighbour_row(field, y, 1);
+        uint32_t* out = field_row(field, field->buffer_w, y);
+        bool odd_row = is_odd_row(field, y);
+        first_word = 0;
+        while(first_word < words){
+            if(mode[first_word] < TILE_STEPPED){
+                ++first_word;
+                continue;
+            }
+            unsigned int end_word = first_word + 1;
+            while(end_word < words && mode[end_word] == mode[first_word])
+                ++end_word;
+            step_row(kernel, &field->rules, above, row, below, out, first_word, end_word, words, field->size_x, field->edge_wrap, odd_row,
+                     (mode[first_word] == TILE_TRACKED) ? changes : NULL);
+            measure_words(field, out, first_word, end_word, y - top);
+            first_word = end_word;
+        }
+    }
+
+    //Tiles of a band the last step skipped were dead, two generations ago as well
+    tile_stats* previous = field->band_skips_r[band] ? NULL : field->tiles_r + (size_t) band * words;
+    uint32_t* captured = tile_array(field, TILE_CAPTURED);
+    uint32_t* top_changes = tile_array(field, TOP_CHANGES);
+    uint32_t* middle_changes = tile_array(field, MIDDLE_CHANGES);
+    uint32_t* bottom_changes = tile_array(field, BOTTOM_CHANGES);
+    unsigned int cycling_tiles = 0;
+    for(unsigned int word = 0; word < words; ++word){
+        tile_stats* tile = &tiles[word];
+        uint16_t earlier_population = tile->population;
+        uint8_t flags = 0;
+        if(mode[word] == TILE_FROZEN){
+            flags = TILE_CYCLED | TILE_EDGES_CYCLED;
+        }else if(mode[word] == TILE_REPLAYED){
+            flags = replay_tile(field, band, word, tile);
+        }else{
+            store_tile(field, tile, word);
+            if(mode[word] == TILE_TRACKED)
+                flags = cycle_flags(field, word, top_changes[word] | middle_changes[word] | bottom_changes[word], top_changes[word] | bottom_changes[word], 2);
+        }
+        if(captured[word] || mode[word] == TILE_REPLAYED)
+            flags |= capture_tile(field, band, word, tile);
+
+        tile->flags = flags;
+        tile->earlier_population = earlier_population;
+        tile->same_as_2 = (previous ? previous[word].same_as_2 << 1 : 0) | (tile->population == earlier_population);
+        tile->same_as_3 = (previous ? previous[word].same_as_3 << 1 : 0) | (tile->population == (previous ? previous[word].earlier_population : 0));
+        cycling_tiles += tile_may_cycle(tile);
+    }
+    field->cycling_tiles += cycling_tiles;
+}
+
+//The rows a step has to visit: the live rows and the ones next to them, plus the rows of the
+//write buffer that still have to be cleared.  An empty range has first_row > last_row
+void step_range(field_data* field, unsigned int* first_row, unsigned int* last_row){
+    field_stats* live = &field->stats_r;
+    field_stats* stale = &field->stats_w;
+    *first_row = 0;
+    *last_row = field->size_y - 1;
+    //Next to a live row on one edge of a wrapping field, the other edge can come alive too
+    if(field->edge_wrap && live->min_y <= live->max_y && (live->min_y == 0 || live->max_y == field->size_y - 1))
+        return;
+
+    *first_row = field->size_y;
+    *last_row = 0;
+    if(live->min_y <= live->max_y){
+        *first_row = live->min_y ? live->min_y - 1 : 0;
+        *last_row = (live->max_y + 1 < field->size_y) ? live->max_y + 1 : live->max_y;
+    }
+    if(stale->min_y <= stale->max_y){
+        if(stale->min_y < *first_row)
+            *first_row = stale->min_y;
+        if(stale->max_y > *last_row)
+            *last_row = stale->max_y;
+    }
+}
+
+void update_and_swap_fields(field_data* field){
+    if(!field->stats_valid)
+        track_field(field);
+
+    row_kernel kernel = find_rule_kernel(&field->rules);
+    //Unless a dead cell with no live neighbours is born, a row can only be alive in the next
+    //generation if it or a row next to it is alive now
+    bool skip_empty = !(field->rules.rules[0] & BE_BORN);
+    unsigned int first_row = 0, last_row = field->size_y - 1;
+    if(skip_empty)
+        step_range(field, &first_row, &last_row);
+
+    unsigned int clean_steps = field->clean_steps;
+    ++field->full_steps;
+    //Tiles are only captured next to ones that may cycle, so without any the search is skipped
+    bool capture = field->cycling_tiles > 0;
+    field->cycling_tiles = 0;
+
+    field_stats stats;
+    empty_stats(field, &stats);
+    for(unsigned int band = 0; band < field->num_bands; ++band){
+        unsigned int top = band * TILE_ROWS;
+        //Bands outside the range are dead in both buffers, so they are left alone
+        if(first_row > last_row || top > last_row || top + TILE_ROWS <= first_row){
+            field->band_skips_w[band] = (field->band_skips_r[band] < 2) ? field->band_skips_r[band] + 1 : 2;
+            continue;
+        }
+        step_band(field, kernel, band, clean_steps, capture);
+        field->band_skips_w[band] = 0;
+        for(unsigned int word = 0; word < field->row_words; ++word)
+            add_tile_stats(&stats, &field->tiles_w[band * field->row_words + word], band, word);
+    }
+    field->stats_w = stats;
 
     swap_buffers(field);
+    field->stats_valid = true;
+    field->clean_steps = (clean_steps < 4) ? clean_steps + 1 : 4;
     return;
 }
 
 void free_field(field_data *field){
+    free(field->tiles_r);
+    free(field->tiles_w);
+    free(field->band_skips_r);
+    free(field->band_skips_w);
+    free(field->tile_scratch);
+    free(field->block_scratch);
     free_accessor(field->buffer_r);
     free_accessor(field->buffer_w);
     free(field->buffer_r);
     free(field->buffer_w);
+    free_arena(&field->memory);
+}
+
+//xorshift64*, so that every field can be seeded reproducibly without sharing rand()'s global state
+uint64_t next_random(uint64_t* state){
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
 }
 
-void seed_field(field_data* field, int seed_rate){
+void seed_field(field_data* field, int seed_rate, uint64_t random_seed){
+    //The generator state must never be zero
+    uint64_t state = random_seed + 0x9E3779B97F4A7C15ULL;
+    if(state == 0)
+        state = 1;
+
     if(seed_rate){
-        for(unsigned int i = 0; i < field->field_len; ++i){
-            bool rand_val = (rand() % seed_rate == 0);
-            set_bit(field->buffer_r, i, rand_val);
+        for(uint64_t i = 0; i < field->field_len; ++i){
+            bool rand_val = (next_random(&state) % seed_rate == 0);
+            set_bit(field->buffer_r, cell_bit_index(field, i), rand_val);
+        }
+    }
+}
+
+void empty_stats(field_data* field, field_stats* stats){
+    stats->population = 0;
+    stats->min_x = field->size_x;
+    stats->max_x = 0;
+    stats->min_y = field->size_y;
+    stats->max_y = 0;
+}
+
+//Without a target that has a popcount instruction, __builtin_popcount is a library call per
+//word.  Counting bits by hand keeps the loops that use this free of calls, so they vectorize
+uint32_t count_bits(uint32_t word){
+    uint32_t bits = word - ((word >> 1) & 0x55555555);
+    bits = (bits & 0x33333333) + ((bits >> 2) & 0x33333333);
+    return (((bits + (bits >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+}
+
+//Adds a row of words, band_row rows from the top of their band, to the tiles being measured
+void measure_words(field_data* field, uint32_t* row, unsigned int first_word, unsigned int end_word, unsigned int band_row){
+    uint32_t* population = tile_array(field, TILE_POPULATION);
+    uint32_t* bits = tile_array(field, TILE_BITS);
+    uint32_t* live_rows = tile_array(field, TILE_LIVE_ROWS);
+    for(unsigned int word = first_word; word < end_word; ++word){
+        population[word] += count_bits(row[word]);
+        bits[word] |= row[word];
+        live_rows[word] |= (uint32_t) (row[word] != 0) << band_row;
+    }
+}
+
+//Copies what measure_words found in one tile to its stats
+void store_tile(field_data* field, tile_stats* tile, unsigned int word){
+    uint32_t bits = tile_array(field, TILE_BITS)[word];
+    uint32_t live_rows = tile_array(field, TILE_LIVE_ROWS)[word];
+    tile->population = tile_array(field, TILE_POPULATION)[word];
+    if(tile->population == 0)
+        return;
+    tile->min_x = __builtin_ctz(bits);
+    tile->max_x = (WORD_BITS - 1) - __builtin_clz(bits);
+    tile->min_y = __builtin_ctz(live_rows);
+    tile->max_y = (WORD_BITS - 1) - __builtin_clz(live_rows);
+}
+
+void add_tile_stats(field_stats* stats, tile_stats* tile, unsigned int band, unsigned int word){
+    if(tile->population == 0)
+        return;
+    stats->population += tile->population;
+    unsigned int x = word * WORD_BITS, y = band * TILE_ROWS;
+    if(x + tile->min_x < stats->min_x)
+        stats->min_x = x + tile->min_x;
+    if(x + tile->max_x > stats->max_x)
+        stats->max_x = x + tile->max_x;
+    if(y + tile->min_y < stats->min_y)
+        stats->min_y = y + tile->min_y;
+    if(y + tile->max_y > stats->max_y)
+        stats->max_y = y + tile->max_y;
+}
+
+//Rebuilds the stats and tiles of buffer_r with a full scan.  Nothing is known about buffer_w, so
+//all of its rows have to be stepped, and no tile is cycled until steps have compared them again
+void track_field(field_data* field){
+    empty_stats(field, &field->stats_r);
+    memset(field->tiles_w, 0, (size_t) field->num_bands * field->row_words * sizeof(tile_stats));
+    for(unsigned int band = 0; band < field->num_bands; ++band){
+        unsigned int top = band * TILE_ROWS;
+        memset(field->tile_scratch, 0, (size_t) TILE_MODE * field->row_words * sizeof(uint32_t));
+        for(unsigned int y = top; y < top + TILE_ROWS && y < field->size_y; ++y)
+            measure_words(field, field_row(field, field->buffer_r, y), 0, field->row_words, y - top);
+
+        tile_stats* tiles = field->tiles_r + (size_t) band * field->row_words;
+        for(unsigned int word = 0; word < field->row_words; ++word){
+            store_tile(field, &tiles[word], word);
+            tiles[word].earlier_population = tiles[word].population;
+            tiles[word].flags = 0;
+            tiles[word].same_as_2 = 0;
+            tiles[word].same_as_3 = 0;
+            add_tile_stats(&field->stats_r, &tiles[word], band, word);
         }
+        field->band_skips_r[band] = 0;
+        field->band_skips_w[band] = 0;
     }
+
+    empty_stats(field, &field->stats_w);
+    field->stats_w.min_y = 0;
+    field->stats_w.max_y = field->size_y - 1;
+    field->stats_valid = true;
+    field->cycling_tiles = 0;
+}
+
+//Free after a full step, since the step keeps the stats up to date.  Anything else scans once
+void measure_field(field_data* field, field_stats* stats){
+    if(!field->stats_valid)
+        track_field(field);
+    *stats = field->stats_r;
+}
+
+void invalidate_field_stats(field_data* field){
+    field->stats_valid = false;
+    field->clean_steps = 0;
+}
+
+//Makes the field read its cells from bitmap, which has the same layout and belongs to someone
+//else, and gives up the generations it kept itself.  The field can not be stepped afterwards
+void view_field_bitmap(field_data* field, uint32_t* bitmap){
+    uint64_t num_bits = field->buffer_r->num_bits;
+    free_arena(&field->memory);
+    init_accessor_at(field->buffer_r, num_bits, bitmap);
+    init_accessor_at(field->buffer_w, num_bits, NULL);
+    field->cycles = NULL;
+    invalidate_field_stats(field);
+}
+
+void set_field_page_mode(enum page_mode mode){
+    field_page_mode = mode;
+}
+
+int init_field(field_data *field, unsigned int width, unsigned int height, int seed_rate, bool edge_wrap, char* rules){
+    return init_field_seeded(field, width, height, seed_rate, time(0), edge_wrap, rules);
 }
 
-int init_field(field_data *field, int width, int height, int seed_rate, bool edge_wrap, char* rules){
-    srand(time(0));
+int init_field_seeded(field_data *field, unsigned int width, unsigned int height, int seed_rate, uint64_t random_seed, bool edge_wrap, char* rules){
     if(!rules)
         rules = DEFAULT_RULES;
 
-    field->field_len = width * height;
+    field->field_len = (uint64_t) width * height;
     field->edge_wrap = edge_wrap;
     field->size_x = width;
     field->size_y = height;
+    field->row_words = num_words_for_bitmap(width);
+    field->row_origin = 0;
+    field->num_bands = (height + TILE_ROWS - 1) / TILE_ROWS;
+    field->stats_valid = false;
+    field->clean_steps = 0;
+    field->full_steps = 0;
+    field->cycling_tiles = 0;
+    field->tiles_r = NULL;
+    field->tiles_w = NULL;
+    field->band_skips_r = NULL;
+    field->band_skips_w = NULL;
+    field->tile_scratch = NULL;
+    field->block_scratch = NULL;
+    field->block_scratch_size = 0;
 
     field->buffer_r = malloc(sizeof(bit_accessor));
     if(field->buffer_r == NULL)
         return OUT_OF_MEM;
 
     field->buffer_w = malloc(sizeof(bit_accessor));
-    if(field->buffer_w == NULL)
+    if(field->buffer_w == NULL){
+        free(field->buffer_r);
         return OUT_OF_MEM;
+    }
 
-    int status = init_accessor(field->buffer_r, field->field_len);
-    if(status != NO_ERR)
+    //Both buffers and the tile cycles share one lazily mapped arena, so rows that are never
+    //written, and tiles that never cycle, never cost memory
+    uint64_t num_bits = (uint64_t) field->row_words * WORD_BITS * height;
+    size_t buffer_len = arena_align(num_words_for_bitmap(num_bits) * sizeof(uint32_t));
+    size_t num_tiles = (size_t) field->num_bands * field->row_words;
+    int status = init_arena(&field->memory, 2 * buffer_len + num_tiles * sizeof(tile_cycle), field_page_mode);
+    if(status != NO_ERR){
+        free(field->buffer_r);
+        free(field->buffer_w);
         return status;
+    }
 
-    status = init_accessor(field->buffer_w, field->field_len);
-    if(status != NO_ERR)
-        return status;
+    init_accessor_at(field->buffer_r, num_bits, field->memory.base);
+    init_accessor_at(field->buffer_w, num_bits, (uint32_t*) ((char*) field->memory.base + buffer_len));
+    field->cycles = (tile_cycle*) ((char*) field->memory.base + 2 * buffer_len);
+
+    field->tiles_r = malloc(num_tiles * sizeof(tile_stats));
+    field->tiles_w = malloc(num_tiles * sizeof(tile_stats));
+    field->band_skips_r = malloc(field->num_bands * sizeof(uint8_t));
+    field->band_skips_w = malloc(field->num_bands * sizeof(uint8_t));
+    field->tile_scratch = malloc((size_t) TILE_SCRATCH_ARRAYS * field->row_words * sizeof(uint32_t));
+    if(field->tiles_r == NULL || field->tiles_w == NULL || field->band_skips_r == NULL || field->band_skips_w == NULL || field->tile_scratch == NULL){
+        free_field(field);
+        return OUT_OF_MEM;
+    }
 
-    seed_field(field, seed_rate);
+    seed_field(field, seed_rate, random_seed);
 
     if(parse_rules(&field->rules, rules)){
         free_field(field);
         return RULE_PARSE_FAIL;
     }
+    fit_hexagonal_torus(field);
     return NO_ERR;
 }
 
+//Hexagonal rows alternate between shifted and unshifted, so a field can only wrap from its bottom
+//row to its top row if its height is even.  An odd height loses its bottom row.  A single row
+//is left alone, since it is its own neighbour above and below either way
+void fit_hexagonal_torus(field_data* field){
+    if(field->rules.neighbourhood != HEXAGONAL || !field->edge_wrap || field->size_y % 2 == 0 || field->size_y == 1)
+        return;
+    //Nothing may be left past the new height, since whole buffers are compared and copied
+    memset(field_row(field, field->buffer_r, field->size_y - 1), 0, field->row_words * sizeof(uint32_t));
+    memset(field_row(field, field->buffer_w, field->size_y - 1), 0, field->row_words * sizeof(uint32_t));
+    --field->size_y;
+    field->field_len = (uint64_t) field->size_x * field->size_y;
+    field->num_bands = (field->size_y + TILE_ROWS - 1) / TILE_ROWS;
+
+    uint64_t num_bits = (uint64_t) field->row_words * WORD_BITS * field->size_y;
+    field->buffer_r->num_bits = field->buffer_w->num_bits = num_bits;
+    field->buffer_r->num_words = field->buffer_w->num_words = num_words_for_bitmap(num_bits);
+    invalidate_field_stats(field);
+}
+
 bool has_prefix(char* string, const char* prefix){
     while(*prefix)
     {
@@ -170,7 +770,7 @@ enum cell_status parse_field_cell(char c){
     return INVALID;
 }
 
-int init_field_file(field_data *field, FILE *fp, int width, int height, bool edge_wrap, char* rules){
+int init_field_file(field_data *field, FILE *fp, unsigned int width, unsigned int height, bool edge_wrap, char* rules){
     if(fp == NULL)
         return FILE_NOT_FOUND;
 
@@ -181,8 +781,8 @@ int init_field_file(field_data *field, FILE *fp, int width, int height, bool edg
         return status;
 
     char inputbuffer[FILE_LINE_LENGTH];
-    unsigned int universal_center = relative_offset(field, 0, field->size_x / 2, field->size_y / 2);
-    unsigned int pattern_cursor = UINT_MAX;
+    uint64_t universal_center = relative_offset(field, 0, field->size_x / 2, field->size_y / 2);
+    uint64_t pattern_cursor = UINT64_MAX;
     unsigned int pattern_newline_offset = 0;
 
     if(fgets(inputbuffer, FILE_LINE_LENGTH, fp)){
@@ -245,8 +845,9 @@ int init_field_file(field_data *field, FILE *fp, int width, int height, bool edg
                 //Life 1.05 file format says to ignore empty lines
                 //If p == inputbuffer and it's a line ending, then the line is empty and we do not increment the cursor.
                 if(is_line_end(p)){
+                    //Step from the last cell written, since a line ending on the right border leaves the cursor on the next row
                     if(p != inputbuffer)
-                        pattern_cursor = pattern_next_line(field, pattern_cursor, pattern_newline_offset);
+                        pattern_cursor = pattern_next_line(field, pattern_cursor - 1, pattern_newline_offset);
                     break;
                 }
 
@@ -266,27 +867,102 @@ int init_field_file(field_data *field, FILE *fp, int width, int height, bool edg
     if(!readFileRules && !readArgRules)
         parse_rules(&field->rules, DEFAULT_RULES);
 
+    fit_hexagonal_torus(field);
     swap_buffers(field);
     return NO_ERR;
 }
 
-bool get_cell(field_data* field, unsigned int offset){
+int save_field_file(field_data* field, FILE* fp){
+    if(fp == NULL)
+        return FILE_NOT_FOUND;
+
+    char rule_string[RULE_STRING_LENGTH];
+    rules_to_string(&field->rules, rule_string);
+    fprintf(fp, "#Life 1.05\n#R %s\n", rule_string);
+
+    int center_x = field->size_x / 2;
+    int center_y = field->size_y / 2;
+    for(unsigned int block_x = 0; block_x < field->size_x; block_x += SAVE_BLOCK_WIDTH){
+        unsigned int block_end = block_x + SAVE_BLOCK_WIDTH;
+        if(block_end > field->size_x)
+            block_end = field->size_x;
+
+        //Only write the rows between the first and last live cell of this block
+        unsigned int first_y = field->size_y;
+        unsigned int last_y = 0;
+        for(unsigned int y = 0; y < field->size_y; ++y){
+            for(unsigned int x = block_x; x < block_end; ++x){
+                if(get_cell(field, (uint64_t) y * field->size_x + x)){
+                    if(first_y == field->size_y)
+                        first_y = y;
+                    last_y = y;
+                    break;
+                }
+            }
+        }
+        if(first_y == field->size_y)
+            continue;
+
+        fprintf(fp, "#P %i %i\n", (int) block_x - center_x, (int) first_y - center_y);
+        for(unsigned int y = first_y; y <= last_y; ++y){
+            //The loader skips empty lines, so a dead row is written as a single dead cell
+            unsigned int line_end = block_x + 1;
+            for(unsigned int x = block_x; x < block_end; ++x){
+                if(get_cell(field, (uint64_t) y * field->size_x + x))
+                    line_end = x + 1;
+            }
+            for(unsigned int x = block_x; x < line_end; ++x)
+                fputc(get_cell(field, (uint64_t) y * field->size_x + x) ? LIVE_CELL : DEAD_CELL, fp);
+            fputc('\n', fp);
+        }
+    }
+    return ferror(fp) ? FILE_WRITE_FAIL : NO_ERR;
+}
+
+uint64_t cell_bit_index(field_data* field, uint64_t offset){
+    uint64_t y = offset / field->size_x;
+    uint64_t x = offset % field->size_x;
+    return (y * field->row_words * WORD_BITS) + x;
+}
+
+uint32_t* field_row(field_data* field, bit_accessor* buffer, unsigned int y){
+    return buffer->bitmap + ((uint64_t) y * field->row_words);
+}
+
+bool is_odd_row(field_data* field, unsigned int y){
+    return (field->row_origin + y) & 1;
+}
+
+bool get_cell(field_data* field, uint64_t offset){
     if(offset >= field->field_len){
         return false;
     }
-    return get_bit(field->buffer_r, offset);
+    return get_bit(field->buffer_r, cell_bit_index(field, offset));
 }
 
+//The stats of each buffer go along with it, but are no longer valid unless a full step did the writing
 inline void swap_buffers(field_data* field){
     bit_accessor* temp = field->buffer_r;
     field->buffer_r = field->buffer_w;
     field->buffer_w = temp;
+
+    field_stats temp_stats = field->stats_r;
+    field->stats_r = field->stats_w;
+    field->stats_w = temp_stats;
+    tile_stats* temp_tiles = field->tiles_r;
+    field->tiles_r = field->tiles_w;
+    field->tiles_w = temp_tiles;
+    uint8_t* temp_skips = field->band_skips_r;
+    field->band_skips_r = field->band_skips_w;
+    field->band_skips_w = temp_skips;
+    field->stats_valid = false;
+    field->clean_steps = 0;
 }
 
-inline void set_cell(field_data* field, unsigned int offset, bool val){
-    set_bit(field->buffer_w, offset, val);
+inline void set_cell(field_data* field, uint64_t offset, bool val){
+    set_bit(field->buffer_w, cell_bit_index(field, offset), val);
 }
 
-inline void toggle_buffer_cell(field_data* field, unsigned int offset){
-    toggle_bit(field->buffer_w, offset);
+inline void toggle_buffer_cell(field_data* field, uint64_t offset){
+    toggle_bit(field->buffer_w, cell_bit_index(field, offset));
 }
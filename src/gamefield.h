@@ -8,6 +8,7 @@
 #include <string.h>
 
 #include "bit_accessor.h"
+#include "arena.h"
 #include "rules.h"
 
 //The lower the seed rate, the more cells will be seeded as "alive" when the program starts
@@ -20,21 +21,117 @@
 //The speed at which the simulation is run
 #define DEFAULT_SPEED 250
 
+//Fields are split into tiles of TILE_ROWS rows by one word, so that full steps can tell which
+//parts of a field have settled
+#define TILE_ROWS 32
+
+//A tile is cycled when the step that wrote it left it as it was two generations before, and its
+//edges are cycled when at least its first and last rows and columns were left that way.  The
+//_3 flags say the same about three generations before, from the tile's cycle
+enum tile_flags{
+    TILE_CYCLED = 1,
+    TILE_EDGES_CYCLED = 2,
+    TILE_CYCLED_3 = 4,
+    TILE_EDGES_CYCLED_3 = 8
+};
+
+//Live cells of one tile, with their extent in cells from its top left corner
+typedef struct tile_stats_t{
+    uint16_t population;
+    //The tile's population two generations before
+    uint16_t earlier_population;
+    uint8_t min_x;
+    uint8_t max_x;
+    uint8_t min_y;
+    uint8_t max_y;
+    uint8_t flags;
+    //Whether the population was the same as two and three generations before, in bit 0 for this
+    //generation, bit 1 for the one before it and so on.  Full steps only track the changes of
+    //tiles whose population has started to repeat
+    uint8_t same_as_2;
+    uint8_t same_as_3;
+} tile_stats;
+
+//The last three generations full steps wrote to a tile, by step number modulo 3, so that a tile
+//repeating itself every three generations can be replayed from them.  Only the tiles that look
+//like they cycle, and their neighbours, are kept, so the rest never touch their pages
+typedef struct tile_cycle_t{
+    uint32_t rows[3][TILE_ROWS];
+    tile_stats stats[3];
+    //The step that last kept a generation here, and how many steps in a row up to it did, up to 3
+    uint64_t last_step;
+    unsigned int captured;
+} tile_cycle;
+
+//Population and live bounding box of a field.  An empty field has min_x > max_x and min_y > max_y
+typedef struct field_stats_t{
+    uint64_t population;
+    unsigned int min_x;
+    unsigned int max_x;
+    unsigned int min_y;
+    unsigned int max_y;
+} field_stats;
+
 typedef struct field_data_t{
     bit_accessor* buffer_r;
     bit_accessor* buffer_w;
+    //Both generation buffers and the tile cycles are carved out of this one mapping
+    arena memory;
 
-    unsigned int field_len;
+    uint64_t field_len;
+    //Every row starts on a word boundary, so a row occupies row_words whole words of the bitmap
+    unsigned int row_words;
     unsigned int size_x;
     unsigned int size_y;
     bool edge_wrap;
     rule_set rules;
+    //Row 0 of this field is this row of the field it is part of, which only differs for shards.
+    //Hexagonal rows are offset by their parity in the whole field
+    unsigned int row_origin;
+
+    //Population, bounding box and tiles of each buffer, by band of TILE_ROWS rows and then by
+    //word.  Full steps keep them up to date as they go, anything else that writes to a buffer
+    //leaves them invalid until the next scan.  A band the step skipped is all dead, and its
+    //tiles were not written.  band_skips counts the steps in a row that skipped it, up to 2
+    field_stats stats_r;
+    field_stats stats_w;
+    unsigned int num_bands;
+    tile_stats* tiles_r;
+    tile_stats* tiles_w;
+    uint8_t* band_skips_r;
+    uint8_t* band_skips_w;
+    tile_cycle* cycles;
+    //Per word arrays a band is stepped with
+    uint32_t* tile_scratch;
+    //Rows temporal blocking advances bands in.  They are allocated the first time the field is
+    //blocked and kept until it is freed, growing if a deeper block needs more
+    void* block_scratch;
+    size_t block_scratch_size;
+    bool stats_valid;
+    //Full steps in a row since anything else wrote to the field, up to 4.  A tile only repeats
+    //itself once every generation it is compared with came from full steps
+    unsigned int clean_steps;
+    //Full steps the field has taken, which number the generations kept in the tile cycles
+    uint64_t full_steps;
+    //Tiles of the read buffer whose populations may be repeating every third generation
+    uint64_t cycling_tiles;
 } field_data;
 
-int init_field(field_data* field, int width, int height, int seed_rate, bool edge_wrap, char* rules);
-int init_field_file(field_data* field, FILE* fp, int width, int height, bool edge_wrap, char* rules);
+void set_field_page_mode(enum page_mode mode);
+int init_field(field_data* field, unsigned int width, unsigned int height, int seed_rate, bool edge_wrap, char* rules);
+int init_field_seeded(field_data* field, unsigned int width, unsigned int height, int seed_rate, uint64_t random_seed, bool edge_wrap, char* rules);
+int init_field_file(field_data* field, FILE* fp, unsigned int width, unsigned int height, bool edge_wrap, char* rules);
 void free_field(field_data* field);
 void update_and_swap_fields(field_data* field);
-bool get_cell(field_data* field, unsigned int offset);
+void update_rows(field_data* field, unsigned int first_row, unsigned int last_row);
+void update_rows_per_cell(field_data* field, unsigned int first_row, unsigned int last_row);
+void swap_buffers(field_data* field);
+bool get_cell(field_data* field, uint64_t offset);
+uint32_t* field_row(field_data* field, bit_accessor* buffer, unsigned int y);
+bool is_odd_row(field_data* field, unsigned int y);
+int save_field_file(field_data* field, FILE* fp);
+void measure_field(field_data* field, field_stats* stats);
+void invalidate_field_stats(field_data* field);
+void view_field_bitmap(field_data* field, uint32_t* bitmap);
 
 #endif
@@ -6,25 +6,131 @@
 #include <unistd.h>
 #include <ncurses.h>
 #include <getopt.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <sys/ioctl.h>
 
 #include "gamefield.h"
+#include "shard.h"
+#include "sweep.h"
+#include "event_loop.h"
+#include "temporal_block.h"
+#include "census.h"
+#include "broadcast.h"
+#include "ansi_screen.h"
+#include "pattern_library.h"
+#include "recording.h"
 #include "errcode.h"
 
+//If drawing falls behind the tick rate, at most this many generations are simulated per frame
+#define MAX_CATCHUP_TICKS 64
+//Longest tick the timer is armed with, about a year, so any --time fits in a timespec
+#define MAX_TICK_NS (365ULL * 24 * 3600 * 1000 * NS_PER_MS)
+#define CENSUS_TEXT_LENGTH 256
+#define INFO_TEXT_LENGTH 512
+#define STATS_TEXT_LENGTH 96
+//How far the picker moves a pattern when the movement key is held with shift
+#define PICKER_JUMP 10
+#define ESCAPE_KEY 27
+//How many recorded frames '[' and ']' skip in a recording
+#define PLAYER_JUMP 10
+
 typedef struct arg_t{
     char* infile;
     char* ruleset;
+    char* checkpoint;
+    char* seed_list;
+    char* random_seeds;
+    char* outfile;
+    char* serve_path;
+    char* view_path;
+    char* library;
+    char* pattern;
+    char* record_path;
+    char* play_path;
     int seed_rate;
-    int game_speed;
+    double game_speed;
+    int shards;
+    int block_depth;
+    int census_interval;
+    int record_interval;
+    int threads;
+    int generations;
+    int size_x;
+    int size_y;
+    enum page_mode page_mode;
     bool widescreen;
+    bool ansi;
     bool wrap_edges;
     bool paused;
+    bool sweep;
     bool help;
 } arg_data;
 
+typedef struct game_state_t{
+    bool running;
+    bool paused;
+    bool show_info;
+    unsigned int generations;
+    //Generation the last census was asked for
+    unsigned int census_generation;
+    //Generation the last broadcast frame showed
+    unsigned int broadcast_generation;
+    //Every record_interval'th generation is written here, if the game is being recorded
+    recorder* recording;
+    //The pattern picker stamps library patterns onto the field, with their top left corner at pick_x, pick_y.
+    //The library is only opened once --pattern or the picker needs it, and library points at
+    //opened_library from then on, or stays NULL if it could not be opened
+    pattern_library* library;
+    pattern_library opened_library;
+    bool library_tried;
+    bool picking;
+    unsigned int picked;
+    int64_t pick_x;
+    int64_t pick_y;
+    //When the oldest key that has not made it to the screen yet was read, or 0 if there is none
+    uint64_t input_ns;
+    uint64_t last_latency_ns;
+    uint64_t total_latency_ns;
+    uint64_t max_latency_ns;
+    unsigned int latency_samples;
+    //Shown on the top line until the next key is pressed, if it is not empty
+    char message[INFO_TEXT_LENGTH];
+    //Set when the simulation can not go on, which ends the game
+    int error;
+} game_state;
+
+//With --ansi the screen is drawn by our own backend instead of curses
+ansi_screen terminal;
+bool ansi_output = false;
+
 void print_error(int err, char** argv);
-void ncurses_init(bool widescreen, int speed, int* x, int* y);
-void draw_and_refresh(field_data field, bool widescreen);
+void ncurses_init(bool widescreen, int* x, int* y);
+void screen_init(bool widescreen, int* x, int* y);
+void screen_end(void);
+void put_cell(unsigned int x, unsigned int y, bool alive);
+void print_line(unsigned int y, const char* text);
+void present_screen(void);
+int read_key(void);
+void put_field_cell(field_data* field, unsigned int x, unsigned int y, bool alive, bool widescreen);
+void draw_field(field_data field, bool widescreen);
+void draw_picker(field_data* field, arg_data* args, game_state* state);
+void handle_picker_key(int ch, field_data* field, game_state* state, bool* handled);
+void draw_frame(field_data* field, arg_data* args, game_state* state, census_worker* census);
+void resize_screen(void);
+void step_generations(field_data* field, shard_sim* shards, arg_data* args, game_state* state, unsigned int generations);
+void handle_key(int ch, field_data* field, shard_sim* shards, arg_data* args, game_state* state);
+int use_pattern_library(arg_data* args, game_state* state);
 int get_opts(arg_data* args, int argc, char** argv);
+int save_checkpoint(field_data* field, char* path);
+int run_sweep_args(arg_data* args);
+uint64_t tick_interval_ns(double game_speed);
+int run_viewer(arg_data* args);
+int run_player(arg_data* args);
+int advance_generations(field_data* field, shard_sim* shards, arg_data* args, unsigned int generations);
 
 int main(int argc, char** argv){
 
@@ -35,73 +141,689 @@ int main(int argc, char** argv){
     __sanitizer_set_report_path("asan.log");
 #endif
 
-    arg_data args = {NULL, NULL, SEED_RATE, DEFAULT_SPEED, false, false, false, false};
+    arg_data args = {
+        .seed_list = "2",
+        .random_seeds = "1",
+        .seed_rate = SEED_RATE,
+        .game_speed = DEFAULT_SPEED,
+        .shards = 1,
+        .block_depth = 1,
+        .generations = SWEEP_GENERATIONS,
+        .size_x = SWEEP_SIZE,
+        .size_y = SWEEP_SIZE,
+        .library = DEFAULT_LIBRARY,
+        .record_interval = 1
+    };
     field_data field;
-    bool running = true;
-    bool step = false;
+    shard_sim shards;
+    event_loop loop;
+    census_worker census;
+    broadcast_server server;
+    recorder rec;
 
     int err = get_opts(&args, argc, argv);
+    set_field_page_mode(args.page_mode);
+
+    //Sweeps run headless, so they never touch the terminal
+    if(!err && args.sweep){
+        err = run_sweep_args(&args);
+        print_error(err, argv);
+        return err ? EXIT_ERR : NO_ERR;
+    }
+    //Viewers only draw what a server sends them, so they never simulate anything
+    if(!err && args.view_path){
+        err = run_viewer(&args);
+        print_error(err, argv);
+        return err ? EXIT_ERR : NO_ERR;
+    }
+    if(!err && args.play_path){
+        err = run_player(&args);
+        print_error(err, argv);
+        return err ? EXIT_ERR : NO_ERR;
+    }
+
     int max_x, max_y;
-    ncurses_init(args.widescreen, args.game_speed, &max_x, &max_y);
-    bool paused = args.paused;
+    ansi_output = args.ansi;
+    screen_init(args.widescreen, &max_x, &max_y);
+    game_state state = {.running = true, .paused = args.paused};
 
-    if(!err){
-        if(args.infile)
-            err = init_field_file(&field, fopen(args.infile, "r"), max_x, max_y, args.wrap_edges, args.ruleset);
-        else
-            err = init_field(&field, max_x, max_y, args.seed_rate, args.wrap_edges, args.ruleset);
+    bool screen_open = true;
+
+    if(!err && args.pattern)
+        err = use_pattern_library(&args, &state);
+    if(err)
+        goto end_screen;
+
+    if(args.infile)
+        err = init_field_file(&field, fopen(args.infile, "r"), max_x, max_y, args.wrap_edges, args.ruleset);
+    else if(args.pattern)
+        err = init_field_pattern(&field, state.library, args.pattern, max_x, max_y, args.wrap_edges, args.ruleset);
+    else
+        err = init_field(&field, max_x, max_y, args.seed_rate, args.wrap_edges, args.ruleset);
+    if(err)
+        goto end_screen;
+
+    //Everything set up from here on is torn down in the reverse order below, from wherever it failed
+    if(args.shards > 1){
+        err = init_shards(&shards, &field, args.shards);
+        if(err)
+            goto release_field;
+    }
+    if(args.census_interval){
+        err = init_census_worker(&census, &field);
+        if(err)
+            goto stop_shards;
+    }
+    err = init_event_loop(&loop, STDIN_FILENO, tick_interval_ns(args.game_speed * args.block_depth));
+    if(err)
+        goto stop_census;
+    if(args.serve_path){
+        err = init_broadcast_server(&server, args.serve_path, &field, &loop);
+        if(err)
+            goto stop_loop;
+    }
+    if(args.record_path){
+        err = init_recorder(&rec, args.record_path, &field, args.record_interval);
+        if(err)
+            goto stop_server;
+        state.recording = &rec;
+        record_frame(&rec, &field, state.generations);
     }
 
-    if(!err){
-        unsigned int generations = 0;
-        draw_and_refresh(field, args.widescreen);
-
-        while(running){
-            int ch = getch();
-            running = (ch != 'q');
-            paused = (paused ^ (ch == ' '));
-            step = (paused && (ch == 's'));
-            if(!paused || step){
-                update_and_swap_fields(&field);
-                draw_and_refresh(field, args.widescreen);
-                ++generations;
-                step = false;
+    arm_ticks(&loop, !state.paused);
+    if(args.census_interval)
+        request_census(&census, &field, state.generations);
+    draw_frame(&field, &args, &state, &census);
+
+    while(state.running){
+        uint64_t ticks;
+        int events = wait_for_events(&loop, &ticks);
+        if(events < 0)
+            break;
+
+        //Read every key that is waiting, so input never holds up the next tick
+        if(events & INPUT_EVENT){
+            int ch;
+            while((ch = read_key()) != ERR){
+                bool was_paused = state.paused;
+                handle_key(ch, &field, &shards, &args, &state);
+                if(state.paused != was_paused)
+                    arm_ticks(&loop, !state.paused);
             }
         }
+        if(events & RESIZE_EVENT)
+            resize_screen();
+        if((events & SOCKET_EVENT) && args.serve_path)
+            serve_viewers(&server);
+        if((events & TICK_EVENT) && !state.paused){
+            if(ticks > MAX_CATCHUP_TICKS)
+                ticks = MAX_CATCHUP_TICKS;
+            //With temporal blocking a tick lasts a whole block, which is advanced in one pass
+            step_generations(&field, &shards, &args, &state, ticks * args.block_depth);
+        }
+        //The census runs on its own thread, and a request is dropped while the last one is still running
+        if(args.census_interval && state.generations - state.census_generation >= (unsigned int) args.census_interval){
+            if(request_census(&census, &field, state.generations))
+                state.census_generation = state.generations;
+        }
+        if(args.serve_path && state.generations != state.broadcast_generation){
+            broadcast_frame(&server, &field, state.generations);
+            state.broadcast_generation = state.generations;
+        }
+        if(events)
+            draw_frame(&field, &args, &state, &census);
+    }
 
-        endwin();
-        free_field(&field);
-        printf("%i generation%s simulated\n", generations, (generations != 1) ? "s" : "");
+    //The summaries below are only printed once the game has run, after the terminal is restored
+    screen_end();
+    screen_open = false;
+    if(args.record_path){
+        uint64_t recorded = rec.recorded_frames, skipped = rec.skipped_frames;
+        if(free_recorder(&rec) != NO_ERR)
+            puts("The recording could not be written completely");
+        printf("%lu frame%s recorded", (unsigned long) recorded, (recorded != 1) ? "s" : "");
+        if(skipped)
+            printf(", %lu skipped because the disk fell behind", (unsigned long) skipped);
+        printf("\n");
+    }
+stop_server:
+    if(args.serve_path){
+        if(!err && server.dropped_frames)
+            printf("%lu frame%s skipped for viewers that fell behind\n", (unsigned long) server.dropped_frames, (server.dropped_frames != 1) ? "s were" : " was");
+        free_broadcast_server(&server);
+    }
+stop_loop:
+    free_event_loop(&loop);
+stop_census:
+    if(args.census_interval){
+        if(!err){
+            char text[CENSUS_TEXT_LENGTH];
+            describe_latest_census(&census, text, CENSUS_TEXT_LENGTH);
+            printf("Last census: %s\n", text);
+        }
+        free_census_worker(&census);
+    }
+stop_shards:
+    if(args.shards > 1)
+        free_shards(&shards);
+release_field:
+    free_field(&field);
+end_screen:
+    if(screen_open)
+        screen_end();
+    if(state.library)
+        free_pattern_library(state.library);
 
+    if(!err){
+        printf("%i generation%s simulated\n", state.generations, (state.generations != 1) ? "s" : "");
+        if(state.latency_samples){
+            printf("Input to screen latency averaged %.1f us (max %.1f us) over %u frame%s with input\n",
+                   (double) state.total_latency_ns / state.latency_samples / NS_PER_US,
+                   (double) state.max_latency_ns / NS_PER_US, state.latency_samples, (state.latency_samples != 1) ? "s" : "");
+        }
+        if(state.error){
+            print_error(state.error, argv);
+            return EXIT_ERR;
+        }
         return NO_ERR;
-
     }
 
-    endwin();
     print_error(err, argv);
-
     if(args.help)
         return NO_ERR;
-
     return EXIT_ERR;
 }
 
-void draw_and_refresh(field_data field, bool widescreen){
-    for(unsigned int offset = 0; offset < field.field_len; ++offset){
-        int cell = 32 | (get_cell(&field, offset) ? 0 : A_REVERSE);
+void screen_init(bool widescreen, int* scr_x, int* scr_y){
+    //Anything that is not a terminal falls back on curses
+    if(ansi_output && init_ansi_screen(&terminal, STDIN_FILENO, STDOUT_FILENO) != NO_ERR)
+        ansi_output = false;
+    if(!ansi_output){
+        ncurses_init(widescreen, scr_x, scr_y);
+        return;
+    }
+    *scr_x = widescreen ? terminal.cols : terminal.cols / 2;
+    *scr_y = terminal.rows;
+}
+
+void screen_end(void){
+    if(ansi_output)
+        free_ansi_screen(&terminal);
+    else
+        endwin();
+}
+
+void put_cell(unsigned int x, unsigned int y, bool alive){
+    if(ansi_output)
+        ansi_put(&terminal, x, y, ' ' | (alive ? 0 : ANSI_REVERSE));
+    else
+        mvaddch(y, x, 32 | (alive ? 0 : A_REVERSE));
+}
+
+//Replaces a whole line of the screen with text
+void print_line(unsigned int y, const char* text){
+    if(ansi_output){
+        ansi_print(&terminal, 0, y, text);
+        ansi_clear_line(&terminal, strlen(text), y);
+    }else{
+        mvaddstr(y, 0, text);
+        clrtoeol();
+    }
+}
+
+void present_screen(void){
+    if(ansi_output)
+        flush_ansi_screen(&terminal);
+    else
+        refresh();
+}
+
+//Keys come out the same as curses' keypad mode gives them, whichever screen is used
+int read_key(void){
+    if(ansi_output){
+        int ch = read_ansi_key(&terminal);
+        switch(ch){
+        case ANSI_KEY_UP:
+            return KEY_UP;
+        case ANSI_KEY_DOWN:
+            return KEY_DOWN;
+        case ANSI_KEY_RIGHT:
+            return KEY_RIGHT;
+        case ANSI_KEY_LEFT:
+            return KEY_LEFT;
+        }
+        return (ch < 0) ? ERR : ch;
+    }
+    return getch();
+}
+
+//Hexagonal fields are drawn with every odd row shifted half a cell to the right, which needs
+//cells that are two characters wide
+void put_field_cell(field_data* field, unsigned int x, unsigned int y, bool alive, bool widescreen){
+    if(widescreen){
+        put_cell(x, y, alive);
+        return;
+    }
+    unsigned int shift = (field->rules.neighbourhood == HEXAGONAL && is_odd_row(field, y)) ? 1 : 0;
+    if(shift && x == 0)
+        put_cell(0, y, false);
+    put_cell(2 * x + shift, y, alive);
+    put_cell(2 * x + 1 + shift, y, alive);
+}
+
+void draw_field(field_data field, bool widescreen){
+    for(uint64_t offset = 0; offset < field.field_len; ++offset){
+        bool alive = get_cell(&field, offset);
         unsigned int x = offset % field.size_x;
         unsigned int y = (offset / field.size_x) % field.size_y;
-        if(widescreen)
-            mvaddch(y, x, cell);
-        else{
-            mvaddch(y, 2 * x, cell);
-            mvaddch(y, 2 * x + 1, cell);
+        put_field_cell(&field, x, y, alive, widescreen);
+    }
+}
+
+//Shows the picked pattern where it would be stamped, on top of the field
+void draw_picker(field_data* field, arg_data* args, game_state* state){
+    pattern_entry* entry = &state->library->entries[state->picked];
+    for(unsigned int y = 0; y < entry->height; ++y){
+        for(unsigned int x = 0; x < entry->width; ++x){
+            int64_t field_x = state->pick_x + x, field_y = state->pick_y + y;
+            if(pattern_cell(state->library, entry, x, y) && field_x >= 0 && field_x < field->size_x && field_y >= 0 && field_y < field->size_y)
+                put_field_cell(field, field_x, field_y, true, args->widescreen);
+        }
+    }
+    char text[INFO_TEXT_LENGTH];
+    snprintf(text, INFO_TEXT_LENGTH, " %s %ux%u | '[' ']' choose | hjkl move | enter stamps | escape closes ",
+             entry->name, entry->width, entry->height);
+    print_line(field->size_y - 1, text);
+}
+
+void draw_frame(field_data* field, arg_data* args, game_state* state, census_worker* census){
+    draw_field(*field, args->widescreen);
+    if(state->picking)
+        draw_picker(field, args, state);
+    //The info lines are drawn over the top rows of the field
+    if(state->show_info){
+        char text[INFO_TEXT_LENGTH];
+        char population_text[STATS_TEXT_LENGTH] = " population - | box - |";
+        //After a full step these come for free.  Shards and temporal blocking leave them invalid,
+        //and a scan every frame would cost as much as a step, so they are only measured while paused
+        if(field->stats_valid || state->paused){
+            field_stats stats;
+            measure_field(field, &stats);
+            snprintf(population_text, STATS_TEXT_LENGTH, " population %" PRIu64 " | box %ux%u |", stats.population,
+                     stats.population ? stats.max_x - stats.min_x + 1 : 0, stats.population ? stats.max_y - stats.min_y + 1 : 0);
+        }
+        snprintf(text, INFO_TEXT_LENGTH, " generation %u |%s tick %.3f ms | input latency %.1f us ",
+                 state->generations, population_text, args->game_speed, (double) state->last_latency_ns / NS_PER_US);
+        print_line(0, text);
+        if(args->census_interval){
+            char census_text[CENSUS_TEXT_LENGTH];
+            describe_latest_census(census, census_text, CENSUS_TEXT_LENGTH);
+            snprintf(text, INFO_TEXT_LENGTH, " %s ", census_text);
+            print_line(1, text);
+        }
+    }
+    if(state->message[0])
+        print_line(0, state->message);
+    present_screen();
+
+    if(state->input_ns){
+        uint64_t latency = monotonic_ns() - state->input_ns;
+        state->last_latency_ns = latency;
+        state->total_latency_ns += latency;
+        if(latency > state->max_latency_ns)
+            state->max_latency_ns = latency;
+        ++state->latency_samples;
+        state->input_ns = 0;
+    }
+}
+
+void resize_screen(void){
+    if(ansi_output){
+        resize_ansi_screen(&terminal);
+        return;
+    }
+    struct winsize size;
+    if(ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0)
+        resizeterm(size.ws_row, size.ws_col);
+    clear();
+}
+
+//Only fails if a shard's worker died
+int advance_generations(field_data* field, shard_sim* shards, arg_data* args, unsigned int generations){
+    if(args->shards > 1){
+        for(unsigned int i = 0; i < generations; ++i){
+            int err = shard_step(shards, field);
+            if(err)
+                return err;
+        }
+    }else if(args->block_depth < 2 || update_fields_blocked(field, generations, args->block_depth) != NO_ERR){
+        for(unsigned int i = 0; i < generations; ++i)
+            update_and_swap_fields(field);
+    }
+    return NO_ERR;
+}
+
+void step_generations(field_data* field, shard_sim* shards, arg_data* args, game_state* state, unsigned int generations){
+    //Stepping stops at every generation that is recorded, however many are simulated per frame
+    while(generations > 0){
+        unsigned int steps = generations;
+        if(state->recording){
+            unsigned int to_record = args->record_interval - state->generations % args->record_interval;
+            if(steps > to_record)
+                steps = to_record;
+        }
+        int err = advance_generations(field, shards, args, steps);
+        if(err){
+            state->error = err;
+            state->running = false;
+            return;
+        }
+        state->generations += steps;
+        generations -= steps;
+        if(state->recording && state->generations % args->record_interval == 0)
+            record_frame(state->recording, field, state->generations);
+    }
+}
+
+//Opens the library the first time it is needed.  Only that first attempt reports why it failed
+int use_pattern_library(arg_data* args, game_state* state){
+    if(state->library_tried)
+        return state->library ? NO_ERR : FILE_NOT_FOUND;
+    state->library_tried = true;
+    int err = open_pattern_library(&state->opened_library, args->library);
+    if(err == NO_ERR)
+        state->library = &state->opened_library;
+    return err;
+}
+
+//Keys the picker uses for itself while it is open.  Anything else still controls the game
+void handle_picker_key(int ch, field_data* field, game_state* state, bool* handled){
+    pattern_entry* entry = &state->library->entries[state->picked];
+    *handled = true;
+    switch(ch){
+    case '[':
+        state->picked = (state->picked + state->library->num_patterns - 1) % state->library->num_patterns;
+        break;
+    case ']':
+        state->picked = (state->picked + 1) % state->library->num_patterns;
+        break;
+    case 'h':
+    case 'H':
+    case KEY_LEFT:
+        state->pick_x -= (ch == 'H') ? PICKER_JUMP : 1;
+        break;
+    case 'l':
+    case 'L':
+    case KEY_RIGHT:
+        state->pick_x += (ch == 'L') ? PICKER_JUMP : 1;
+        break;
+    case 'k':
+    case 'K':
+    case KEY_UP:
+        state->pick_y -= (ch == 'K') ? PICKER_JUMP : 1;
+        break;
+    case 'j':
+    case 'J':
+    case KEY_DOWN:
+        state->pick_y += (ch == 'J') ? PICKER_JUMP : 1;
+        break;
+    case '\r':
+    case '\n':
+    case KEY_ENTER:
+        stamp_pattern(field, state->library, entry, state->pick_x, state->pick_y);
+        break;
+    case ESCAPE_KEY:
+    case 'p':
+        state->picking = false;
+        break;
+    default:
+        *handled = false;
+    }
+}
+
+void handle_key(int ch, field_data* field, shard_sim* shards, arg_data* args, game_state* state){
+    if(state->input_ns == 0)
+        state->input_ns = monotonic_ns();
+    state->message[0] = '\0';
+
+    if(state->picking){
+        bool handled;
+        handle_picker_key(ch, field, state, &handled);
+        if(handled)
+            return;
+    }
+
+    switch(ch){
+    case 'q':
+        state->running = false;
+        break;
+    case ' ':
+        state->paused = !state->paused;
+        break;
+    case 's':
+        if(state->paused)
+            step_generations(field, shards, args, state, 1);
+        break;
+    case 'c':
+        if(args->checkpoint){
+            if(save_checkpoint(field, args->checkpoint) == NO_ERR)
+                snprintf(state->message, INFO_TEXT_LENGTH, " Saved generation %u to %s ", state->generations, args->checkpoint);
+            else
+                snprintf(state->message, INFO_TEXT_LENGTH, " Could not save the checkpoint to %s: %s ", args->checkpoint, strerror(errno));
+        }
+        break;
+    case 'i':
+        state->show_info = !state->show_info;
+        break;
+    case 'p':
+        //Shards each keep their own rows of the field, so there is nothing here to stamp onto
+        if(args->shards > 1)
+            break;
+        if(use_pattern_library(args, state) == NO_ERR && state->library->num_patterns){
+            pattern_entry* entry = &state->library->entries[state->picked];
+            state->picking = true;
+            state->pick_x = (int64_t) (field->size_x / 2) - entry->width / 2;
+            state->pick_y = (int64_t) (field->size_y / 2) - entry->height / 2;
+        }else
+            snprintf(state->message, INFO_TEXT_LENGTH, " No patterns in %s ", args->library);
+        break;
+    }
+}
+
+int run_sweep_args(arg_data* args){
+    sweep_config config = {
+        .rules = args->ruleset,
+        .seed_rates = args->seed_list,
+        .random_seeds = args->random_seeds,
+        .width = args->size_x,
+        .height = args->size_y,
+        .generations = args->generations,
+        .threads = args->threads,
+        .edge_wrap = args->wrap_edges,
+        .out = stdout
+    };
+    if(args->outfile){
+        config.out = fopen(args->outfile, "w");
+        if(config.out == NULL)
+            return FILE_NOT_FOUND;
+    }
+
+    int err = run_sweep(&config);
+    if(args->outfile)
+        fclose(config.out);
+    return err;
+}
+
+int run_viewer(arg_data* args){
+    broadcast_viewer viewer;
+    event_loop loop;
+
+    int err = init_event_loop(&loop, STDIN_FILENO, tick_interval_ns(args->game_speed));
+    if(err)
+        return err;
+    err = connect_viewer(&viewer, args->view_path, &loop);
+    if(err){
+        free_event_loop(&loop);
+        return err;
+    }
+
+    int max_x, max_y;
+    ansi_output = args->ansi;
+    screen_init(args->widescreen, &max_x, &max_y);
+    bool running = true, show_info = false;
+    while(running){
+        uint64_t ticks;
+        int events = wait_for_events(&loop, &ticks);
+        if(events < 0)
+            break;
+
+        if(events & INPUT_EVENT){
+            int ch;
+            while((ch = read_key()) != ERR){
+                if(ch == 'q')
+                    running = false;
+                else if(ch == 'i')
+                    show_info = !show_info;
+            }
+        }
+        if(events & RESIZE_EVENT)
+            resize_screen();
+        bool new_frame = false;
+        if(events & SOCKET_EVENT){
+            err = receive_frames(&viewer, &new_frame);
+            if(err)
+                running = false;
+            //The server going away ends the viewer normally
+            if(err == BROADCAST_FAIL)
+                err = NO_ERR;
+        }
+        if((new_frame || (events & (INPUT_EVENT | RESIZE_EVENT))) && viewer.has_field){
+            draw_field(viewer.field, args->widescreen);
+            if(show_info){
+                char text[INFO_TEXT_LENGTH];
+                snprintf(text, INFO_TEXT_LENGTH, " viewing generation %lu ", (unsigned long) viewer.generation);
+                print_line(0, text);
+            }
+            present_screen();
         }
     }
-    refresh();
+
+    screen_end();
+    free_viewer(&viewer);
+    free_event_loop(&loop);
+    return err;
 }
 
-void ncurses_init(bool widescreen, int speed, int* scr_x, int* scr_y){
+//Plays a recording at the game's speed.  Paused, it can be stepped through and rewound
+int run_player(arg_data* args){
+    recording_player player;
+    event_loop loop;
+
+    int err = open_recording(&player, args->play_path);
+    if(err)
+        return err;
+    err = init_event_loop(&loop, STDIN_FILENO, tick_interval_ns(args->game_speed));
+    if(err){
+        close_recording(&player);
+        return err;
+    }
+
+    int max_x, max_y;
+    ansi_output = args->ansi;
+    screen_init(args->widescreen, &max_x, &max_y);
+    bool running = true, paused = args->paused, show_info = false;
+    arm_ticks(&loop, !paused);
+    while(running){
+        uint64_t ticks;
+        int events = wait_for_events(&loop, &ticks);
+        if(events < 0)
+            break;
+
+        bool ended = false;
+        if(events & INPUT_EVENT){
+            int ch;
+            while((ch = read_key()) != ERR && !err){
+                uint64_t interval = player.header.interval;
+                switch(ch){
+                case 'q':
+                    running = false;
+                    break;
+                case 'i':
+                    show_info = !show_info;
+                    break;
+                case ' ':
+                    paused = !paused;
+                    arm_ticks(&loop, !paused);
+                    break;
+                case 's':
+                    err = next_recorded_frame(&player, &ended);
+                    break;
+                case 'b':
+                    if(player.generation > 0)
+                        err = seek_recording(&player, player.generation - 1);
+                    break;
+                case '[':
+                    err = seek_recording(&player, (player.generation > PLAYER_JUMP * interval) ? player.generation - PLAYER_JUMP * interval : 0);
+                    break;
+                case ']':
+                    err = seek_recording(&player, player.generation + PLAYER_JUMP * interval);
+                    break;
+                }
+            }
+        }
+        if(events & RESIZE_EVENT)
+            resize_screen();
+        if((events & TICK_EVENT) && !paused){
+            for(uint64_t i = 0; i < ticks && !ended && !err; ++i)
+                err = next_recorded_frame(&player, &ended);
+            //The last frame stays on the screen until the player is closed
+            if(ended){
+                paused = true;
+                arm_ticks(&loop, false);
+            }
+        }
+        if(err)
+            running = false;
+        if(events){
+            draw_field(player.field, args->widescreen);
+            if(show_info){
+                char text[INFO_TEXT_LENGTH];
+                snprintf(text, INFO_TEXT_LENGTH, " playing generation %" PRIu64 " of %" PRIu64 " | recorded every %u | [ ] jump, b s step ",
+                         player.generation, player.last_generation, player.header.interval);
+                print_line(0, text);
+            }
+            present_screen();
+        }
+    }
+
+    screen_end();
+    close_recording(&player);
+    free_event_loop(&loop);
+    return err;
+}
+
+//Timers with an interval of 0 never fire, so very short ticks are rounded up to 1 ns
+uint64_t tick_interval_ns(double game_speed){
+    double interval = game_speed * NS_PER_MS;
+    if(interval < 1)
+        return 1;
+    if(interval > MAX_TICK_NS)
+        return MAX_TICK_NS;
+    return interval;
+}
+
+int save_checkpoint(field_data* field, char* path){
+    FILE* fp = fopen(path, "w");
+    if(fp == NULL)
+        return FILE_NOT_FOUND;
+    int err = save_field_file(field, fp);
+    //Buffered writes only fail once they are flushed
+    if(fclose(fp) != 0 && !err)
+        err = FILE_WRITE_FAIL;
+    return err;
+}
+
+void ncurses_init(bool widescreen, int* scr_x, int* scr_y){
     initscr();
     raw();
     keypad(stdscr, true);
@@ -109,7 +831,8 @@ void ncurses_init(bool widescreen, int speed, int* scr_x, int* scr_y){
     curs_set(0);
     *scr_x = widescreen ? getmaxx(stdscr) : getmaxx(stdscr) / 2;
     *scr_y = getmaxy(stdscr);
-    timeout(speed);
+    //The event loop only reads keys once it knows they are there
+    nodelay(stdscr, true);
 }
 
 int get_opts(arg_data* args, int argc, char** argv){
@@ -121,14 +844,34 @@ int get_opts(arg_data* args, int argc, char** argv){
         {"edge-wrap", no_argument, 0, 'e'},
         {"pause", no_argument, 0, 'p'},
         {"time", required_argument, 0, 't'},
+        {"shards", required_argument, 0, 'j'},
+        {"checkpoint", required_argument, 0, 'c'},
+        {"sweep", no_argument, 0, 'S'},
+        {"random-seeds", required_argument, 0, 'R'},
+        {"size", required_argument, 0, 'z'},
+        {"generations", required_argument, 0, 'g'},
+        {"threads", required_argument, 0, 'T'},
+        {"output", required_argument, 0, 'o'},
+        {"block", required_argument, 0, 'b'},
+        {"huge-pages", required_argument, 0, 'u'},
+        {"census", required_argument, 0, 'k'},
+        {"serve", required_argument, 0, 'P'},
+        {"view", required_argument, 0, 'V'},
+        {"ansi", no_argument, 0, 'A'},
+        {"record", required_argument, 0, 'd'},
+        {"record-every", required_argument, 0, 'E'},
+        {"play", required_argument, 0, 'y'},
+        {"library", required_argument, 0, 'l'},
+        {"pattern", required_argument, 0, 'n'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
     int option_index = 0;
     int argres = 0;
+    char* end;
     while(1){
 
-        argres = getopt_long(argc, argv, "f:s:r:whept:", long_options, &option_index);
+        argres = getopt_long(argc, argv, "f:s:r:whept:j:c:SR:z:g:T:o:b:u:k:P:V:Al:n:d:E:y:", long_options, &option_index);
 
         if(argres == -1)
             break;
@@ -138,9 +881,9 @@ int get_opts(arg_data* args, int argc, char** argv){
             args->wrap_edges = true;
             break;
         case 't':
-            args->game_speed = atoi(optarg);
-            if(args->game_speed < 1){
-                puts("Time argument must be positive integer");
+            args->game_speed = strtod(optarg, &end);
+            if(end == optarg || *end != '\0' || !(args->game_speed > 0 && isfinite(args->game_speed))){
+                puts("Time argument must be positive number");
                 return ARG_ERR;
             }
             break;
@@ -157,19 +900,123 @@ int get_opts(arg_data* args, int argc, char** argv){
             args->ruleset = optarg;
             break;
         case 's':
-            args->seed_rate = atoi(optarg);
-            if(args->seed_rate < 1){
-                puts("Seed argument must be positive integer");
-                return ARG_ERR;
-            }
+            //Sweeps take a list here, so it is only checked once every option has been read
+            args->seed_list = optarg;
             break;
         case 'p':
             args->paused = true;
             break;
+        case 'j':
+            args->shards = atoi(optarg);
+            if(args->shards < 1){
+                puts("Shard argument must be positive integer");
+                return ARG_ERR;
+            }
+            break;
+        case 'c':
+            args->checkpoint = optarg;
+            break;
+        case 'S':
+            args->sweep = true;
+            break;
+        case 'R':
+            args->random_seeds = optarg;
+            break;
+        case 'z':
+            if(sscanf(optarg, "%ix%i", &args->size_x, &args->size_y) != 2 || args->size_x < 1 || args->size_y < 1){
+                puts("Size argument must be two positive integers, eg 64x64");
+                return ARG_ERR;
+            }
+            break;
+        case 'g':
+            args->generations = atoi(optarg);
+            if(args->generations < 1){
+                puts("Generations argument must be positive integer");
+                return ARG_ERR;
+            }
+            break;
+        case 'T':
+            args->threads = atoi(optarg);
+            if(args->threads < 1){
+                puts("Threads argument must be positive integer");
+                return ARG_ERR;
+            }
+            break;
+        case 'o':
+            args->outfile = optarg;
+            break;
+        case 'b':
+            args->block_depth = atoi(optarg);
+            if(args->block_depth < 1 || args->block_depth > MAX_BLOCK_DEPTH){
+                printf("Block argument must be an integer from 1 to %i\n", MAX_BLOCK_DEPTH);
+                return ARG_ERR;
+            }
+            break;
+        case 'A':
+            args->ansi = true;
+            break;
+        case 'P':
+            args->serve_path = optarg;
+            break;
+        case 'V':
+            args->view_path = optarg;
+            break;
+        case 'd':
+            args->record_path = optarg;
+            break;
+        case 'E':
+            args->record_interval = atoi(optarg);
+            if(args->record_interval < 1){
+                puts("Record interval argument must be positive integer");
+                return ARG_ERR;
+            }
+            break;
+        case 'y':
+            args->play_path = optarg;
+            break;
+        case 'l':
+            args->library = optarg;
+            break;
+        case 'n':
+            args->pattern = optarg;
+            break;
+        case 'k':
+            args->census_interval = atoi(optarg);
+            if(args->census_interval < 1){
+                puts("Census argument must be positive integer");
+                return ARG_ERR;
+            }
+            break;
+        case 'u':
+            if(strcmp(optarg, "transparent") == 0)
+                args->page_mode = TRANSPARENT_HUGE_PAGES;
+            else if(strcmp(optarg, "explicit") == 0)
+                args->page_mode = EXPLICIT_HUGE_PAGES;
+            else{
+                puts("Huge pages argument must be 'transparent' or 'explicit'");
+                return ARG_ERR;
+            }
+            break;
         default:
             return ARG_ERR;
         }
     }
+    if(!args->sweep && args->seed_list != NULL){
+        long seed_rate = strtol(args->seed_list, &end, 10);
+        if(end == args->seed_list || *end != '\0' || seed_rate < 1 || seed_rate > INT_MAX){
+            puts("Seed argument must be positive integer");
+            return ARG_ERR;
+        }
+        args->seed_rate = seed_rate;
+    }
+    if(args->infile && args->pattern){
+        puts("A game can start from a file or a pattern, but not both");
+        return ARG_ERR;
+    }
+    if(args->shards > 1 && args->block_depth > 1){
+        puts("Sharded simulations cannot use temporal blocking");
+        return ARG_ERR;
+    }
     if(optind < argc){
         printf("Non-option argument");
         if(argc - optind > 1)
@@ -186,8 +1033,11 @@ int get_opts(arg_data* args, int argc, char** argv){
 void print_error(int err, char** argv){
     switch(err){
     case PRINT_HELP:
-        printf("\nUsage:\n %s [args]\n\nPossible arguments:\n --file, -f\t\tLife_1.05_file\n --seed, -s\t\tseed_rate_number\n --rule, -r\t\truleset_string\n --widescreen, -w\n --edge-wrap, -e\n --time, -t\t\ttime_speed\n --pause, -p\n --help, -h\n", argv[0]);
+        printf("\nUsage:\n %s [args]\n\nPossible arguments:\n --file, -f\t\tLife_1.05_file\n --seed, -s\t\tseed_rate_number\n --rule, -r\t\truleset_string\n --widescreen, -w\n --ansi, -A\n --edge-wrap, -e\n --time, -t\t\ttime_speed\n --pause, -p\n --shards, -j\t\tworker_processes\n --checkpoint, -c\tLife_1.05_file\n --sweep, -S\n --random-seeds, -R\tseed_list\n --size, -z\t\twidthxheight\n --generations, -g\tnumber\n --threads, -T\t\tnumber\n --output, -o\t\tresults_file\n --block, -b\t\tgenerations_per_tick\n --huge-pages, -u\ttransparent|explicit\n --census, -k\t\tgenerations\n --serve, -P\t\tsocket_path\n --view, -V\t\tsocket_path\n --record, -d\t\trecording_file\n --record-every, -E\tgenerations\n --play, -y\t\trecording_file\n --library, -l\t\tdirectory\n --pattern, -n\t\tname\n --help, -h\n", argv[0]);
         puts("\nTo control the game, press 'q' to exit, space to pause, and 's' while paused to advance one generation.");
+        puts("When a checkpoint file is given, press 'c' to save the current generation to it.  Press 'i' to show the generation, tick length and input latency.");
+        puts("When playing a recording, press space to pause, 's' and 'b' to step forward and back, and '[' and ']' to skip 10 frames.");
+        puts("Press 'p' to open the pattern picker, '[' and ']' to choose a pattern, 'hjkl' to move it, enter to stamp it and escape to close the picker.");
         return;
     case ARG_ERR:
         printf("Try '%s --help' for more information\n", argv[0]);
@@ -210,9 +1060,33 @@ void print_error(int err, char** argv){
     case FILE_DUPE_ATTR:
         puts("Specified file had duplicate attribute tags");
         return;
+    case FILE_WRITE_FAIL:
+        puts("Could not write the specified file");
+        return;
     case RULE_PARSE_FAIL:
         puts("Specified ruleset is improperly formatted (check #R tag in file or the program arguments)");
         return;
+    case EVENT_LOOP_FAIL:
+        puts("Could not set up the timer and input event loop");
+        return;
+    case CENSUS_INIT_FAIL:
+        puts("Could not start the census thread");
+        return;
+    case BROADCAST_FAIL:
+        puts("Could not open the broadcast socket, or the broadcast ended");
+        return;
+    case FRAME_FORMAT_FAIL:
+        puts("Received or read a frame that could not be decoded");
+        return;
+    case RECORDING_FAIL:
+        puts("Could not open the recording file, or start the thread that writes it");
+        return;
+    case PATTERN_NOT_FOUND:
+        puts("The pattern library has no pattern with that name");
+        return;
+    case SHARD_INIT_FAIL:
+        puts("Could not set up the shared memory or worker processes for a sharded simulation, or a worker died");
+        return;
     case OUT_OF_MEM:
         puts("Not enough memory");
         return;
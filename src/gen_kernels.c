@@ -0,0 +1,241 @@
+//Build time generator for the specialized row kernels in rule_kernels.c.  For every common rule
+//it minimizes the next state function of (alive, count bits) with Quine-McCluskey, treating the
+//neighbour counts its neighbourhood can not reach as don't cares, and writes it out as plain
+//bitwise logic.
+
+#include <stdio.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "rules.h"
+
+//Inputs of the next state function: the cell itself plus the 4 bit neighbour count
+#define NUM_INPUTS 5
+#define NUM_MINTERMS (1 << NUM_INPUTS)
+#define ALIVE_BIT (1 << 4)
+#define COUNT_MASK 0b1111
+#define FUNCTION_NAME_LENGTH 64
+//Every implicant is one of the 3^5 possible terms
+#define MAX_IMPLICANTS 243
+
+typedef struct common_rule_t{
+    const char* name;
+    char* rule_string;
+} common_rule;
+
+//Rule strings are in the Alive/Born format used everywhere else in the program
+common_rule common_rules[] = {
+    {"Conway's Life B3/S23", "23/3"},
+    {"HighLife B36/S23", "23/36"},
+    {"Seeds B2/S", "/2"},
+    {"Day & Night B3678/S34678", "34678/3678"},
+    {"Life without Death B3/S012345678", "012345678/3"},
+    {"Hexagonal Life B2/S34H", "34/2H"},
+    {"Von Neumann B1/S1V", "1/1V"},
+    {NULL, NULL}
+};
+
+//An implicant covers every minterm that matches value on the bits that are not in dont_care
+typedef struct implicant_t{
+    unsigned int value;
+    unsigned int dont_care;
+} implicant;
+
+//Variable names in the generated code, from the lowest minterm bit to the highest
+const char* input_names[NUM_INPUTS] = {"count_0", "count_1", "count_2", "count_3", "alive"};
+//Neighbour counter that goes with each neighbourhood, in the order of enum neighbourhood
+const char* count_functions[] = {"count_neighbour_words", "count_hexagonal_words", "count_von_neumann_words"};
+
+enum term_value{
+    TERM_OFF = 0,
+    TERM_ON,
+    TERM_DONT_CARE
+};
+
+enum term_value truth_table(rule_set* rules, unsigned int minterm);
+int prime_implicants(enum term_value* table, implicant* primes);
+bool covers(implicant term, unsigned int minterm);
+int literal_count(implicant term);
+int minimal_cover(enum term_value* table, implicant* primes, int num_primes, implicant* cover);
+void function_name(char* name, char* rule_string);
+void write_kernel(rule_set* rules, char* rule_string);
+
+enum term_value truth_table(rule_set* rules, unsigned int minterm){
+    unsigned int count = minterm & COUNT_MASK;
+    if((int) count > neighbourhood_size(rules->neighbourhood))
+        return TERM_DONT_CARE;
+    return next_cell_state(rules, (minterm & ALIVE_BIT) != 0, count) ? TERM_ON : TERM_OFF;
+}
+
+int prime_implicants(enum term_value* table, implicant* primes){
+    implicant current[MAX_IMPLICANTS], next[MAX_IMPLICANTS];
+    bool merged[MAX_IMPLICANTS];
+    int num_current = 0, num_primes = 0;
+
+    for(unsigned int m = 0; m < NUM_MINTERMS; ++m){
+        if(table[m] != TERM_OFF)
+            current[num_current++] = (implicant) {m, 0};
+    }
+
+    while(num_current > 0){
+        int num_next = 0;
+        for(int i = 0; i < num_current; ++i)
+            merged[i] = false;
+
+        for(int i = 0; i < num_current; ++i){
+            for(int j = i + 1; j < num_current; ++j){
+                unsigned int difference = current[i].value ^ current[j].value;
+                if(current[i].dont_care != current[j].dont_care || __builtin_popcount(difference) != 1)
+                    continue;
+                merged[i] = merged[j] = true;
+                implicant combined = {current[i].value & ~difference, current[i].dont_care | difference};
+
+                bool duplicate = false;
+                for(int k = 0; k < num_next && !duplicate; ++k)
+                    duplicate = (next[k].value == combined.value && next[k].dont_care == combined.dont_care);
+                if(!duplicate)
+                    next[num_next++] = combined;
+            }
+        }
+
+        for(int i = 0; i < num_current; ++i){
+            if(!merged[i])
+                primes[num_primes++] = current[i];
+        }
+        for(int i = 0; i < num_next; ++i)
+            current[i] = next[i];
+        num_current = num_next;
+    }
+    return num_primes;
+}
+
+bool covers(implicant term, unsigned int minterm){
+    return (minterm & ~term.dont_care) == term.value;
+}
+
+int literal_count(implicant term){
+    return NUM_INPUTS - __builtin_popcount(term.dont_care);
+}
+
+int minimal_cover(enum term_value* table, implicant* primes, int num_primes, implicant* cover){
+    bool covered[NUM_MINTERMS];
+    int num_cover = 0;
+    for(unsigned int m = 0; m < NUM_MINTERMS; ++m)
+        covered[m] = (table[m] != TERM_ON);
+
+    //Essential primes first, then greedily whichever prime covers the most of what is left
+    for(unsigned int m = 0; m < NUM_MINTERMS; ++m){
+        if(covered[m])
+            continue;
+        int only = -1, num_covering = 0;
+        for(int p = 0; p < num_primes; ++p){
+            if(covers(primes[p], m)){
+                only = p;
+                ++num_covering;
+            }
+        }
+        if(num_covering == 1){
+            cover[num_cover++] = primes[only];
+            for(unsigned int n = 0; n < NUM_MINTERMS; ++n)
+                covered[n] |= covers(primes[only], n);
+        }
+    }
+
+    while(true){
+        int best = -1, best_gain = 0;
+        for(int p = 0; p < num_primes; ++p){
+            int gain = 0;
+            for(unsigned int m = 0; m < NUM_MINTERMS; ++m)
+                gain += (!covered[m] && covers(primes[p], m));
+            if(gain > best_gain || (gain == best_gain && gain > 0 && literal_count(primes[p]) < literal_count(primes[best]))){
+                best = p;
+                best_gain = gain;
+            }
+        }
+        if(best < 0)
+            break;
+        cover[num_cover++] = primes[best];
+        for(unsigned int m = 0; m < NUM_MINTERMS; ++m)
+            covered[m] |= covers(primes[best], m);
+    }
+    return num_cover;
+}
+
+void function_name(char* name, char* rule_string){
+    char* p = name + sprintf(name, "s");
+    for(char* c = rule_string; *c != '\0'; ++c){
+        if(*c == '/')
+            p += sprintf(p, "_b");
+        else if(isalpha(*c))
+            p += sprintf(p, "_%c", tolower(*c));
+        else
+            *p++ = *c;
+    }
+    *p = '\0';
+}
+
+void write_kernel(rule_set* rules, char* rule_string){
+    enum term_value table[NUM_MINTERMS];
+    implicant primes[MAX_IMPLICANTS];
+    implicant cover[NUM_MINTERMS];
+    char name[FUNCTION_NAME_LENGTH];
+
+    for(unsigned int m = 0; m < NUM_MINTERMS; ++m)
+        table[m] = truth_table(rules, m);
+    int num_primes = prime_implicants(table, primes);
+    int num_cover = minimal_cover(table, primes, num_primes, cover);
+
+    function_name(name, rule_string);
+    printf("static inline uint32_t next_state_%s(uint32_t alive, uint32_t count_0, uint32_t count_1, uint32_t count_2, uint32_t count_3){\n", name);
+    printf("    return ");
+    if(num_cover == 0)
+        printf("0");
+    for(int t = 0; t < num_cover; ++t){
+        if(t > 0)
+            printf("\n         | ");
+        if(literal_count(cover[t]) == 0){
+            printf("~(uint32_t) 0");
+            continue;
+        }
+        printf("(");
+        bool first = true;
+        for(int bit = NUM_INPUTS - 1; bit >= 0; --bit){
+            if(cover[t].dont_care & (1 << bit))
+                continue;
+            printf("%s%s%s", first ? "" : " & ", (cover[t].value & (1 << bit)) ? "" : "~", input_names[bit]);
+            first = false;
+        }
+        printf(")");
+    }
+    printf(";\n}\n\n");
+    printf("static DEFINE_ROW_KERNEL(step_row_%s, next_state_%s, %s)\n\n", name, name, count_functions[rules->neighbourhood]);
+}
+
+int main(){
+    rule_set rules;
+
+    printf("//Generated by gen_kernels, do not edit\n\n");
+    printf("#include \"kernels.h\"\n\n");
+    for(common_rule* r = common_rules; r->name != NULL; ++r){
+        if(parse_rules(&rules, r->rule_string)){
+            fprintf(stderr, "Could not parse rule string '%s'\n", r->rule_string);
+            return 1;
+        }
+        printf("//%s\n", r->name);
+        write_kernel(&rules, r->rule_string);
+    }
+
+    printf("const rule_kernel_entry RULE_KERNELS[] = {\n");
+    for(common_rule* r = common_rules; r->name != NULL; ++r){
+        char name[FUNCTION_NAME_LENGTH];
+        parse_rules(&rules, r->rule_string);
+        function_name(name, r->rule_string);
+        printf("    {\"%s\", {", r->name);
+        for(int i = 0; i < NUM_RULES; ++i)
+            printf("%s%i", i ? ", " : "", rules.rules[i]);
+        printf("}, %i, step_row_%s},\n", rules.neighbourhood, name);
+    }
+    printf("    {NULL, {0}, 0, NULL}\n};\n");
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include <string.h>
+
+#include "kernels.h"
+
+static inline uint32_t apply_rules(rule_set* rules, uint32_t alive, uint32_t* count, int max_neighbours, int planes);
+
+row_kernel find_rule_kernel(rule_set* rules){
+    for(const rule_kernel_entry* entry = RULE_KERNELS; entry->name != NULL; ++entry){
+        if(entry->neighbourhood == rules->neighbourhood && memcmp(entry->rules, rules->rules, sizeof(entry->rules)) == 0)
+            return entry->step_row;
+    }
+    return NULL;
+}
+
+//Next generation of a word of cells, for any rule, from its neighbour count planes.  Smaller
+//neighbourhoods pass their own limits, so less of the rule has to be checked
+static inline uint32_t apply_rules(rule_set* rules, uint32_t alive, uint32_t* count, int max_neighbours, int planes){
+    uint32_t next = 0;
+    for(int neighbours = 0; neighbours <= max_neighbours; ++neighbours){
+        enum rule_type rule = rules->rules[neighbours];
+        if(rule == DIE)
+            continue;
+        //Every bit whose count planes spell out this number of neighbours
+        uint32_t matches = ~(uint32_t) 0;
+        for(int plane = 0; plane < planes; ++plane)
+            matches &= ((neighbours >> plane) & 1) ? count[plane] : ~count[plane];
+        if(rule & KEEP_ALIVE)
+            next |= matches & alive;
+        if(rule & BE_BORN)
+            next |= matches & ~alive;
+    }
+    return next;
+}
+
+void step_row_generic(rule_set* rules, uint32_t* above, uint32_t* row, uint32_t* below, uint32_t* out, unsigned int first_word, unsigned int end_word, unsigned int words, unsigned int width, bool wrap, uint32_t* changes){
+    uint32_t count[COUNT_PLANES];
+    for(unsigned int word = first_word; word < end_word; ++word){
+        count_neighbour_words(above, row, below, word, words, width, wrap, false, count);
+        uint32_t next = apply_rules(rules, row[word], count, 8, COUNT_PLANES);
+        if(word == words - 1)
+            next &= last_word_mask(width);
+        uint32_t changed = store_word(out + word, next);
+        if(changes)
+            changes[word] |= changed;
+    }
+}
+
+void step_row_hexagonal(rule_set* rules, uint32_t* above, uint32_t* row, uint32_t* below, uint32_t* out, unsigned int first_word, unsigned int end_word, unsigned int words, unsigned int width, bool wrap, bool odd_row, uint32_t* changes){
+    uint32_t count[COUNT_PLANES];
+    for(unsigned int word = first_word; word < end_word; ++word){
+        count_hexagonal_words(above, row, below, word, words, width, wrap, odd_row, count);
+        uint32_t next = apply_rules(rules, row[word], count, 6, COUNT_PLANES - 1);
+        if(word == words - 1)
+            next &= last_word_mask(width);
+        uint32_t changed = store_word(out + word, next);
+        if(changes)
+            changes[word] |= changed;
+    }
+}
+
+void step_row_von_neumann(rule_set* rules, uint32_t* above, uint32_t* row, uint32_t* below, uint32_t* out, unsigned int first_word, unsigned int end_word, unsigned int words, unsigned int width, bool wrap, uint32_t* changes){
+    uint32_t count[COUNT_PLANES];
+    for(unsigned int word = first_word; word < end_word; ++word){
+        count_von_neumann_words(above, row, below, word, words, width, wrap, false, count);
+        uint32_t next = apply_rules(rules, row[word], count, 4, COUNT_PLANES - 1);
+        if(word == words - 1)
+            next &= last_word_mask(width);
+        uint32_t changed = store_word(out + word, next);
+        if(changes)
+            changes[word] |= changed;
+    }
+}
+
+//Rules without a specialized kernel fall back on the generic one for their neighbourhood
+void step_row(row_kernel kernel, rule_set* rules, uint32_t* above, uint32_t* row, uint32_t* below, uint32_t* out, unsigned int first_word, unsigned int end_word, unsigned int words, unsigned int width, bool wrap, bool odd_row, uint32_t* changes){
+    if(kernel)
+        kernel(above, row, below, out, first_word, end_word, words, width, wrap, odd_row, changes);
+    else if(rules->neighbourhood == HEXAGONAL)
+        step_row_hexagonal(rules, above, row, below, out, first_word, end_word, words, width, wrap, odd_row, changes);
+    else if(rules->neighbourhood == VON_NEUMANN)
+        step_row_von_neumann(rules, above, row, below, out, first_word, end_word, words, width, wrap, changes);
+    else
+        step_row_generic(rules, above, row, below, out, first_word, end_word, words, width, wrap, changes);
+}
@@ -0,0 +1,177 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "rules.h"
+
+//Number of bit planes needed to hold a neighbour count of 0 to 8.  The smaller neighbourhoods
+//only use the first 3
+#define COUNT_PLANES 4
+
+//Computes words first_word to end_word - 1 of one row of the next generation, a whole word of
+//cells at a time.  above and below are NULL when the row is on the border of a field that does
+//not wrap.  odd_row only matters to hexagonal fields, where it is the row's parity in the whole
+//field.  Unless changes is NULL, every bit of out that changed is ORed into the same word of it
+typedef void (*row_kernel)(uint32_t* above, uint32_t* row, uint32_t* below, uint32_t* out, unsigned int first_word, unsigned int end_word, unsigned int words, unsigned int width, bool wrap, bool odd_row, uint32_t* changes);
+
+typedef struct rule_kernel_entry_t{
+    const char* name;
+    enum rule_type rules[NUM_RULES];
+    enum neighbourhood neighbourhood;
+    row_kernel step_row;
+} rule_kernel_entry;
+
+//Generated at build time by gen_kernels.  The last entry has a NULL name
+extern const rule_kernel_entry RULE_KERNELS[];
+
+row_kernel find_rule_kernel(rule_set* rules);
+void step_row_generic(rule_set* rules, uint32_t* above, uint32_t* row, uint32_t* below, uint32_t* out, unsigned int first_word, unsigned int end_word, unsigned int words, unsigned int width, bool wrap, uint32_t* changes);
+void step_row_hexagonal(rule_set* rules, uint32_t* above, uint32_t* row, uint32_t* below, uint32_t* out, unsigned int first_word, unsigned int end_word, unsigned int words, unsigned int width, bool wrap, bool odd_row, uint32_t* changes);
+void step_row_von_neumann(rule_set* rules, uint32_t* above, uint32_t* row, uint32_t* below, uint32_t* out, unsigned int first_word, unsigned int end_word, unsigned int words, unsigned int width, bool wrap, uint32_t* changes);
+void step_row(row_kernel kernel, rule_set* rules, uint32_t* above, uint32_t* row, uint32_t* below, uint32_t* out, unsigned int first_word, unsigned int end_word, unsigned int words, unsigned int width, bool wrap, bool odd_row, uint32_t* changes);
+
+//Bit x of west holds cell x-1 of the row and bit x of east holds cell x+1
+static inline void shift_row_word(uint32_t* row, unsigned int word, unsigned int words, unsigned int width, bool wrap, uint32_t* west, uint32_t* east){
+    if(row == NULL){
+        *west = 0;
+        *east = 0;
+        return;
+    }
+    uint32_t current = row[word];
+    uint32_t previous = (word > 0) ? row[word - 1] : 0;
+    uint32_t next = (word + 1 < words) ? row[word + 1] : 0;
+    *west = (current << 1) | (previous >> 31);
+    *east = (current >> 1) | (next << 31);
+
+    if(wrap){
+        unsigned int last = width - 1;
+        if(word == 0)
+            *west |= (row[last >> 5] >> (last & 31)) & 1;
+        if(word == (last >> 5))
+            *east |= (row[0] & 1) << (last & 31);
+    }
+}
+
+//Adds up the 8 neighbours of 32 cells at once.  Bit x of count[i] is bit i of cell x's neighbour
+//count.  Every neighbourhood's counter takes the same arguments, though only hexagonal fields
+//care about odd_row
+static inline void count_neighbour_words(uint32_t* above, uint32_t* row, uint32_t* below, unsigned int word, unsigned int words, unsigned int width, bool wrap, bool odd_row, uint32_t* count){
+    uint32_t west, east;
+
+    //Each row's contribution as a 2 bit number: the row above and below add 3 cells, the row itself 2
+    shift_row_word(above, word, words, width, wrap, &west, &east);
+    uint32_t centre = above ? above[word] : 0;
+    uint32_t above_0 = west ^ centre ^ east;
+    uint32_t above_1 = (west & centre) | (east & (west ^ centre));
+
+    shift_row_word(below, word, words, width, wrap, &west, &east);
+    centre = below ? below[word] : 0;
+    uint32_t below_0 = west ^ centre ^ east;
+    uint32_t below_1 = (west & centre) | (east & (west ^ centre));
+
+    shift_row_word(row, word, words, width, wrap, &west, &east);
+    uint32_t middle_0 = west ^ east;
+    uint32_t middle_1 = west & east;
+
+    //Add the ones, then the twos along with the carry out of the ones
+    uint32_t partial = above_0 ^ below_0;
+    count[0] = partial ^ middle_0;
+    uint32_t carry = (above_0 & below_0) | (middle_0 & partial);
+
+    uint32_t pair_ab = above_1 ^ below_1;
+    uint32_t pair_mc = middle_1 ^ carry;
+    count[1] = pair_ab ^ pair_mc;
+    uint32_t carry_ab = above_1 & below_1;
+    uint32_t carry_mc = middle_1 & carry;
+    uint32_t carry_pairs = pair_ab & pair_mc;
+    //At most two of the three carries can be set at once
+    count[2] = carry_ab ^ carry_mc ^ carry_pairs;
+    count[3] = (carry_ab & carry_mc) | (carry_pairs & (carry_ab | carry_mc));
+}
+
+//Adds up the 6 neighbours of 32 cells at once on a field with offset rows.  The row above and
+//below each add the two cells that overlap a cell: the one under it and the one to its left on
+//an even row, or to its right on an odd row
+static inline void count_hexagonal_words(uint32_t* above, uint32_t* row, uint32_t* below, unsigned int word, unsigned int words, unsigned int width, bool wrap, bool odd_row, uint32_t* count){
+    uint32_t west, east;
+
+    shift_row_word(above, word, words, width, wrap, &west, &east);
+    uint32_t centre = above ? above[word] : 0;
+    uint32_t side = odd_row ? east : west;
+    uint32_t above_0 = centre ^ side;
+    uint32_t above_1 = centre & side;
+
+    shift_row_word(below, word, words, width, wrap, &west, &east);
+    centre = below ? below[word] : 0;
+    side = odd_row ? east : west;
+    uint32_t below_0 = centre ^ side;
+    uint32_t below_1 = centre & side;
+
+    shift_row_word(row, word, words, width, wrap, &west, &east);
+    uint32_t middle_0 = west ^ east;
+    uint32_t middle_1 = west & east;
+
+    uint32_t partial = above_0 ^ below_0;
+    count[0] = partial ^ middle_0;
+    uint32_t carry = (above_0 & below_0) | (middle_0 & partial);
+
+    //The twos add up to at most 3, so there is no carry out of the last plane
+    uint32_t pair_ab = above_1 ^ below_1;
+    uint32_t pair_mc = middle_1 ^ carry;
+    count[1] = pair_ab ^ pair_mc;
+    count[2] = (above_1 & below_1) | (middle_1 & carry) | (pair_ab & pair_mc);
+    count[3] = 0;
+}
+
+//Adds up the 4 orthogonal neighbours of 32 cells at once
+static inline void count_von_neumann_words(uint32_t* above, uint32_t* row, uint32_t* below, unsigned int word, unsigned int words, unsigned int width, bool wrap, bool odd_row, uint32_t* count){
+    uint32_t west, east;
+    shift_row_word(row, word, words, width, wrap, &west, &east);
+    uint32_t north = above ? above[word] : 0;
+    uint32_t south = below ? below[word] : 0;
+
+    uint32_t pair_ns = north ^ south;
+    uint32_t pair_we = west ^ east;
+    count[0] = pair_ns ^ pair_we;
+    uint32_t carry_ns = north & south;
+    uint32_t carry_we = west & east;
+    count[1] = carry_ns ^ carry_we ^ (pair_ns & pair_we);
+    count[2] = carry_ns & carry_we;
+    count[3] = 0;
+}
+
+static inline uint32_t last_word_mask(unsigned int width){
+    unsigned int used_bits = width & 31;
+    return used_bits ? ((uint32_t) 1 << used_bits) - 1 : ~(uint32_t) 0;
+}
+
+//Never writes a dead word over a dead word, so pages of a lazily mapped field that only
+//ever hold dead cells stay unbacked.  Returns the bits that changed
+static inline uint32_t store_word(uint32_t* out, uint32_t value){
+    uint32_t previous = *out;
+    if(value != 0 || previous != 0)
+        *out = value;
+    return previous ^ value;
+}
+
+//Defines a row_kernel from a function that maps a word of cells and its neighbour count planes
+//to the next generation, and the counter for its neighbourhood.  The padding past the last
+//column is always cleared.  changes never overlaps the rows, and saying so keeps the loop vectorized
+#define DEFINE_ROW_KERNEL(kernel_name, next_state, count_words) \
+void kernel_name(uint32_t* above, uint32_t* row, uint32_t* below, uint32_t* out, unsigned int first_word, unsigned int end_word, unsigned int words, unsigned int width, bool wrap, bool odd_row, uint32_t* restrict changes){ \
+    uint32_t count[COUNT_PLANES]; \
+    for(unsigned int word = first_word; word < end_word; ++word){ \
+        count_words(above, row, below, word, words, width, wrap, odd_row, count); \
+        uint32_t next = next_state(row[word], count[0], count[1], count[2], count[3]); \
+        if(word == words - 1) \
+            next &= last_word_mask(width); \
+        uint32_t changed = store_word(out + word, next); \
+        if(changes) \
+            changes[word] |= changed; \
+    } \
+}
+
+#endif
@@ -0,0 +1,456 @@
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "pattern_library.h"
+#include "kernels.h"
+#include "errcode.h"
+
+#define PATTERN_EXTENSION ".lif"
+//Loading a file takes a field twice as large as the file's furthest line from the origin, which
+//would be absurd for any real pattern past this
+#define MAX_PATTERN_EXTENT (1 << 20)
+//An index larger than this is not read, and the library is parsed again instead
+#define MAX_INDEX_SIZE (256 * 1024 * 1024)
+
+void pattern_name(char* name, const char* file_name);
+int compare_names(const void* a, const void* b);
+int compare_entry_name(const void* name, const void* entry);
+int list_pattern_files(const char* directory, char*** names, unsigned int* num_names);
+void free_names(char** names, unsigned int num_names);
+void life_file_extents(FILE* fp, int64_t* min_x, int64_t* max_x, int64_t* min_y, int64_t* max_y, bool* has_rule);
+void copy_bits(uint32_t* out, uint32_t* row, unsigned int row_words, uint64_t from_x, unsigned int width);
+int parse_pattern(const char* path, const char* file_name, struct stat* info, pattern_entry* entry, uint32_t** bitmap);
+bool entry_matches(pattern_entry* entry, struct stat* info);
+bool load_index(const char* path, pattern_library* library);
+void write_index(const char* path, uint8_t* data, size_t len);
+
+//A pattern is named after its file, without the extension
+void pattern_name(char* name, const char* file_name){
+    snprintf(name, PATTERN_NAME_LENGTH, "%.*s", (int) (strlen(file_name) - strlen(PATTERN_EXTENSION)), file_name);
+}
+
+int compare_names(const void* a, const void* b){
+    return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+int compare_entry_name(const void* name, const void* entry){
+    return strcmp(name, ((const pattern_entry*) entry)->name);
+}
+
+//Every Life 1.05 file in the directory, sorted, so the index always lists them in the same order
+int list_pattern_files(const char* directory, char*** names, unsigned int* num_names){
+    DIR* dir = opendir(directory);
+    if(dir == NULL)
+        return FILE_NOT_FOUND;
+
+    unsigned int capacity = 16;
+    *num_names = 0;
+    *names = malloc(capacity * sizeof(char*));
+    if(*names == NULL){
+        closedir(dir);
+        return OUT_OF_MEM;
+    }
+
+    struct dirent* file;
+    while((file = readdir(dir)) != NULL){
+        size_t len = strlen(file->d_name);
+        size_t extension_len = strlen(PATTERN_EXTENSION);
+        //Names that do not fit in an entry could never be asked for, so they are left out
+        if(len <= extension_len || len - extension_len >= PATTERN_NAME_LENGTH || strcmp(file->d_name + len - extension_len, PATTERN_EXTENSION) != 0)
+            continue;
+        if(*num_names == capacity){
+            capacity *= 2;
+            char** grown = realloc(*names, capacity * sizeof(char*));
+            if(grown == NULL){
+                free_names(*names, *num_names);
+                closedir(dir);
+                return OUT_OF_MEM;
+            }
+            *names = grown;
+        }
+        (*names)[(*num_names)++] = strdup(file->d_name);
+    }
+    closedir(dir);
+    qsort(*names, *num_names, sizeof(char*), compare_names);
+    return NO_ERR;
+}
+
+void free_names(char** names, unsigned int num_names){
+    for(unsigned int i = 0; i < num_names; ++i)
+        free(names[i]);
+    free(names);
+}
+
+//Finds how far the file's cell lines reach from the origin, which is all it takes to size a
+//field that can hold them, and whether it has a rule tag
+void life_file_extents(FILE* fp, int64_t* min_x, int64_t* max_x, int64_t* min_y, int64_t* max_y, bool* has_rule){
+    char inputbuffer[FILE_LINE_LENGTH];
+    bool in_block = false, line_start = true;
+    long block_x = 0, cursor_y = 0, column = 0;
+    *min_x = *min_y = *max_x = *max_y = 0;
+    *has_rule = false;
+
+    while(fgets(inputbuffer, FILE_LINE_LENGTH, fp)){
+        if(line_start && inputbuffer[0] == '#'){
+            if(inputbuffer[1] == 'R' || inputbuffer[1] == 'N')
+                *has_rule = true;
+            if(inputbuffer[1] == 'P' && sscanf(inputbuffer + 2, "%ld %ld", &block_x, &cursor_y) == 2)
+                in_block = true;
+            line_start = (strchr(inputbuffer, '\n') != NULL);
+            continue;
+        }
+
+        //A line longer than the buffer arrives in pieces
+        size_t len = strcspn(inputbuffer, "\r\n");
+        bool line_end = (inputbuffer[len] != '\0');
+        if(in_block && len > 0){
+            if(block_x + column < *min_x)
+                *min_x = block_x + column;
+            if(block_x + column + (long) len - 1 > *max_x)
+                *max_x = block_x + column + len - 1;
+            if(cursor_y < *min_y)
+                *min_y = cursor_y;
+            if(cursor_y > *max_y)
+                *max_y = cursor_y;
+        }
+        column += len;
+        if(line_end){
+            //Empty lines are skipped, they do not move the cursor down
+            if(column > 0)
+                ++cursor_y;
+            column = 0;
+        }
+        line_start = line_end;
+    }
+}
+
+//Copies width cells starting at from_x out of a field row, into a row that starts on a word boundary
+void copy_bits(uint32_t* out, uint32_t* row, unsigned int row_words, uint64_t from_x, unsigned int width){
+    unsigned int words = num_words_for_bitmap(width);
+    uint64_t first_word = from_x / WORD_BITS;
+    unsigned int shift = from_x % WORD_BITS;
+    for(unsigned int i = 0; i < words; ++i){
+        uint32_t word = row[first_word + i] >> shift;
+        if(shift && first_word + i + 1 < row_words)
+            word |= row[first_word + i + 1] << (WORD_BITS - shift);
+        out[i] = word;
+    }
+    out[words - 1] &= last_word_mask(width);
+}
+
+//Loads the file the same way --file does, into a field just big enough for it, and keeps the
+//bounding box of what ended up alive
+int parse_pattern(const char* path, const char* file_name, struct stat* info, pattern_entry* entry, uint32_t** bitmap){
+    FILE* fp = fopen(path, "r");
+    if(fp == NULL)
+        return FILE_NOT_FOUND;
+
+    int64_t min_x, max_x, min_y, max_y;
+    bool has_rule;
+    life_file_extents(fp, &min_x, &max_x, &min_y, &max_y, &has_rule);
+    rewind(fp);
+    int64_t half_x = ((-min_x > max_x) ? -min_x : max_x) + 2;
+    int64_t half_y = ((-min_y > max_y) ? -min_y : max_y) + 2;
+    if(half_x > MAX_PATTERN_EXTENT || half_y > MAX_PATTERN_EXTENT){
+        fclose(fp);
+        return FILE_LAYOUT_MALFORM;
+    }
+
+    field_data field;
+    int status = init_field_file(&field, fp, 2 * half_x, 2 * half_y, false, NULL);
+    fclose(fp);
+    if(status != NO_ERR)
+        return status;
+    field_stats stats;
+    measure_field(&field, &stats);
+
+    memset(entry, 0, sizeof(*entry));
+    pattern_name(entry->name, file_name);
+    if(has_rule)
+        rules_to_string(&field.rules, entry->rule);
+    entry->mtime_sec = info->st_mtim.tv_sec;
+    entry->mtime_nsec = info->st_mtim.tv_nsec;
+    entry->file_size = info->st_size;
+    entry->population = stats.population;
+    *bitmap = NULL;
+    if(stats.population){
+        entry->offset_x = (int64_t) stats.min_x - field.size_x / 2;
+        entry->offset_y = (int64_t) stats.min_y - field.size_y / 2;
+        entry->width = stats.max_x - stats.min_x + 1;
+        entry->height = stats.max_y - stats.min_y + 1;
+        entry->row_words = num_words_for_bitmap(entry->width);
+        *bitmap = malloc((size_t) entry->row_words * entry->height * sizeof(uint32_t));
+        if(*bitmap == NULL){
+            free_field(&field);
+            return OUT_OF_MEM;
+        }
+        for(unsigned int y = 0; y < entry->height; ++y)
+            copy_bits(*bitmap + (size_t) y * entry->row_words, field_row(&field, field.buffer_r, stats.min_y + y), field.row_words, stats.min_x, entry->width);
+    }
+    free_field(&field);
+    return NO_ERR;
+}
+
+bool entry_matches(pattern_entry* entry, struct stat* info){
+    return entry->mtime_sec == info->st_mtim.tv_sec && entry->mtime_nsec == info->st_mtim.tv_nsec
+           && entry->file_size == (uint64_t) info->st_size;
+}
+
+//Reads an existing index, as long as it is one we can read and everything in it is in bounds.
+//It is copied rather than mapped, since another process rewriting or truncating a mapped file
+//would crash the game on its next access
+bool load_index(const char* path, pattern_library* library){
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+        return false;
+    struct stat info;
+    if(fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(library_header) || info.st_size > MAX_INDEX_SIZE){
+        close(fd);
+        return false;
+    }
+    size_t len = info.st_size;
+    uint8_t* data = malloc(len);
+    size_t received = 0;
+    while(data != NULL && received < len){
+        ssize_t got = read(fd, data + received, len - received);
+        if(got <= 0 && !(got < 0 && errno == EINTR))
+            break;
+        if(got > 0)
+            received += got;
+    }
+    close(fd);
+    if(data == NULL || received != len){
+        free(data);
+        return false;
+    }
+
+    library_header* header = (library_header*) data;
+    size_t entries_len = (size_t) header->num_patterns * sizeof(pattern_entry);
+    bool valid = header->magic == LIBRARY_MAGIC && header->version == LIBRARY_VERSION
+                 && header->num_patterns <= len / sizeof(pattern_entry) && header->bitmap_words <= len / sizeof(uint32_t)
+                 && len == sizeof(library_header) + entries_len + header->bitmap_words * sizeof(uint32_t);
+    pattern_entry* entries = (pattern_entry*) (data + sizeof(library_header));
+    for(unsigned int i = 0; valid && i < header->num_patterns; ++i){
+        pattern_entry* entry = &entries[i];
+        valid = memchr(entry->name, '\0', PATTERN_NAME_LENGTH) && memchr(entry->rule, '\0', PATTERN_RULE_LENGTH)
+                && entry->row_words == num_words_for_bitmap(entry->width)
+                && entry->bitmap_offset + (uint64_t) entry->row_words * entry->height <= header->bitmap_words;
+    }
+    if(!valid){
+        free(data);
+        return false;
+    }
+
+    library->data = data;
+    library->len = len;
+    library->from_index = true;
+    library->rebuilt = false;
+    library->entries = entries;
+    library->num_patterns = header->num_patterns;
+    library->bitmaps = (uint32_t*) (data + sizeof(library_header) + entries_len);
+    return true;
+}
+
+//The index is only a cache, so a directory we can not write to just means parsing again next time
+void write_index(const char* path, uint8_t* data, size_t len){
+    char temp_path[PATH_MAX];
+    snprintf(temp_path, PATH_MAX, "%s.%ld", path, (long) getpid());
+    FILE* fp = fopen(temp_path, "wb");
+    if(fp == NULL)
+        return;
+    bool written = (fwrite(data, 1, len, fp) == len);
+    if(fclose(fp) != 0 || !written || rename(temp_path, path) != 0)
+        unlink(temp_path);
+}
+
+int open_pattern_library(pattern_library* library, const char* directory){
+    char** names;
+    unsigned int num_names;
+    int status = list_pattern_files(directory, &names, &num_names);
+    if(status != NO_ERR)
+        return status;
+
+    char path[PATH_MAX];
+    char index_path[PATH_MAX];
+    snprintf(index_path, PATH_MAX, "%s/%s", directory, LIBRARY_INDEX_NAME);
+    pattern_library old;
+    bool have_old = load_index(index_path, &old);
+
+    struct stat* infos = calloc(num_names ? num_names : 1, sizeof(struct stat));
+    if(infos == NULL){
+        free_names(names, num_names);
+        if(have_old)
+            free_pattern_library(&old);
+        return OUT_OF_MEM;
+    }
+    for(unsigned int i = 0; i < num_names; ++i){
+        snprintf(path, PATH_MAX, "%s/%s", directory, names[i]);
+        stat(path, &infos[i]);
+    }
+
+    //Nothing to do if the index lists exactly these files and none of them changed since
+    char name[PATTERN_NAME_LENGTH];
+    bool current = have_old && old.num_patterns == num_names;
+    for(unsigned int i = 0; current && i < num_names; ++i){
+        pattern_name(name, names[i]);
+        current = strcmp(old.entries[i].name, name) == 0 && entry_matches(&old.entries[i], &infos[i]);
+    }
+    if(current){
+        *library = old;
+        free(infos);
+        free_names(names, num_names);
+        return NO_ERR;
+    }
+
+    //Otherwise only the files that are new or changed are parsed again
+    pattern_entry* entries = calloc(num_names ? num_names : 1, sizeof(pattern_entry));
+    uint32_t** bitmaps = calloc(num_names ? num_names : 1, sizeof(uint32_t*));
+    status = (entries && bitmaps) ? NO_ERR : OUT_OF_MEM;
+    unsigned int num_patterns = 0;
+    uint64_t bitmap_words = 0;
+    for(unsigned int i = 0; status == NO_ERR && i < num_names; ++i){
+        pattern_name(name, names[i]);
+        pattern_entry* previous = have_old ? find_pattern(&old, name) : NULL;
+        pattern_entry* entry = &entries[num_patterns];
+        size_t words = 0;
+
+        if(previous && entry_matches(previous, &infos[i])){
+            *entry = *previous;
+            words = (size_t) entry->row_words * entry->height;
+            if(words){
+                bitmaps[num_patterns] = malloc(words * sizeof(uint32_t));
+                if(bitmaps[num_patterns] == NULL){
+                    status = OUT_OF_MEM;
+                    break;
+                }
+                memcpy(bitmaps[num_patterns], pattern_bitmap(&old, previous), words * sizeof(uint32_t));
+            }
+        }else{
+            snprintf(path, PATH_MAX, "%s/%s", directory, names[i]);
+            int parsed = parse_pattern(path, names[i], &infos[i], entry, &bitmaps[num_patterns]);
+            if(parsed == OUT_OF_MEM)
+                status = OUT_OF_MEM;
+            //A file that does not load is left out of the library, just as it would fail with --file
+            if(parsed != NO_ERR)
+                continue;
+            words = (size_t) entry->row_words * entry->height;
+        }
+        entry->bitmap_offset = bitmap_words;
+        bitmap_words += words;
+        ++num_patterns;
+    }
+
+    size_t entries_len = (size_t) num_patterns * sizeof(pattern_entry);
+    size_t len = sizeof(library_header) + entries_len + bitmap_words * sizeof(uint32_t);
+    uint8_t* data = (status == NO_ERR) ? malloc(len) : NULL;
+    if(data == NULL)
+        status = OUT_OF_MEM;
+    if(status == NO_ERR){
+        library_header header = {LIBRARY_MAGIC, LIBRARY_VERSION, num_patterns, 0, bitmap_words};
+        memcpy(data, &header, sizeof(header));
+        memcpy(data + sizeof(header), entries, entries_len);
+        uint32_t* out = (uint32_t*) (data + sizeof(header) + entries_len);
+        for(unsigned int i = 0; i < num_patterns; ++i){
+            if(bitmaps[i])
+                memcpy(out + entries[i].bitmap_offset, bitmaps[i], (size_t) entries[i].row_words * entries[i].height * sizeof(uint32_t));
+        }
+
+        library->data = data;
+        library->len = len;
+        library->from_index = false;
+        library->rebuilt = true;
+        library->entries = (pattern_entry*) (data + sizeof(header));
+        library->num_patterns = num_patterns;
+        library->bitmaps = out;
+        write_index(index_path, data, len);
+    }
+
+    for(unsigned int i = 0; bitmaps && i < num_names; ++i)
+        free(bitmaps[i]);
+    free(bitmaps);
+    free(entries);
+    free(infos);
+    free_names(names, num_names);
+    if(have_old)
+        free_pattern_library(&old);
+    return status;
+}
+
+void free_pattern_library(pattern_library* library){
+    free(library->data);
+    library->data = NULL;
+}
+
+pattern_entry* find_pattern(pattern_library* library, const char* name){
+    return bsearch(name, library->entries, library->num_patterns, sizeof(pattern_entry), compare_entry_name);
+}
+
+uint32_t* pattern_bitmap(pattern_library* library, pattern_entry* entry){
+    return library->bitmaps + entry->bitmap_offset;
+}
+
+bool pattern_cell(pattern_library* library, pattern_entry* entry, unsigned int x, unsigned int y){
+    uint32_t* row = pattern_bitmap(library, entry) + (size_t) y * entry->row_words;
+    return (row[x / WORD_BITS] >> (x % WORD_BITS)) & 1;
+}
+
+//ORs the pattern into the current generation with its top left corner at x, y.  Rows that fit
+//on the field are copied a word at a time, anything that hangs over an edge wraps around or is
+//dropped, depending on the field
+void stamp_pattern(field_data* field, pattern_library* library, pattern_entry* entry, int64_t x, int64_t y){
+    uint32_t* bitmap = pattern_bitmap(library, entry);
+    bool fits = (x >= 0 && x + entry->width <= field->size_x);
+    for(unsigned int r = 0; r < entry->height; ++r){
+        int64_t field_y = y + r;
+        if(field_y < 0 || field_y >= field->size_y){
+            if(!field->edge_wrap)
+                continue;
+            field_y = ((field_y % field->size_y) + field->size_y) % field->size_y;
+        }
+        uint32_t* row = field_row(field, field->buffer_r, field_y);
+        uint32_t* source = bitmap + (size_t) r * entry->row_words;
+
+        if(fits){
+            uint32_t* out = row + x / WORD_BITS;
+            unsigned int shift = x % WORD_BITS;
+            for(unsigned int i = 0; i < entry->row_words; ++i){
+                out[i] |= source[i] << shift;
+                if(shift && x / WORD_BITS + i + 1 < field->row_words)
+                    out[i + 1] |= source[i] >> (WORD_BITS - shift);
+            }
+            continue;
+        }
+        for(unsigned int c = 0; c < entry->width; ++c){
+            if(!((source[c / WORD_BITS] >> (c % WORD_BITS)) & 1))
+                continue;
+            int64_t field_x = x + c;
+            if(field_x < 0 || field_x >= field->size_x){
+                if(!field->edge_wrap)
+                    continue;
+                field_x = ((field_x % field->size_x) + field->size_x) % field->size_x;
+            }
+            row[field_x / WORD_BITS] |= (uint32_t) 1 << (field_x % WORD_BITS);
+        }
+    }
+    invalidate_field_stats(field);
+}
+
+//Starts a field with one pattern from the library, placed where --file would have put it
+int init_field_pattern(field_data* field, pattern_library* library, const char* name, unsigned int width, unsigned int height, bool edge_wrap, char* rules){
+    pattern_entry* entry = find_pattern(library, name);
+    if(entry == NULL)
+        return PATTERN_NOT_FOUND;
+
+    //Like a file's tags, the pattern's own rule takes precedence
+    int status = init_field(field, width, height, 0, edge_wrap, entry->rule[0] ? entry->rule : rules);
+    if(status != NO_ERR)
+        return status;
+    stamp_pattern(field, library, entry, (int64_t) (field->size_x / 2) + entry->offset_x, (int64_t) (field->size_y / 2) + entry->offset_y);
+    return NO_ERR;
+}
@@ -0,0 +1,68 @@
+#ifndef PATTERN_LIBRARY_H
+#define PATTERN_LIBRARY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "gamefield.h"
+
+#define LIBRARY_MAGIC 0x42494C50U
+#define LIBRARY_VERSION 1
+//Kept in the library directory, next to the patterns it was built from
+#define LIBRARY_INDEX_NAME ".pattern_index"
+#define PATTERN_NAME_LENGTH 64
+#define PATTERN_RULE_LENGTH 32
+#define DEFAULT_LIBRARY "Patterns"
+
+//The index starts with this header, then one entry per pattern sorted by name, then the bitmaps
+typedef struct library_header_t{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_patterns;
+    uint32_t padding;
+    uint64_t bitmap_words;
+} library_header;
+
+//A pattern as it was parsed from its Life 1.05 file, cut down to its bounding box.  The
+//bitmap has the same layout as a field's, with every row starting on a word boundary
+typedef struct pattern_entry_t{
+    char name[PATTERN_NAME_LENGTH];
+    //Rule from the file's #R or #N tag, or an empty string if it had none
+    char rule[PATTERN_RULE_LENGTH];
+    //The source file is parsed again whenever either of these change
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint64_t file_size;
+    //Where the bounding box sits relative to the centre of a field the file is loaded into
+    int32_t offset_x;
+    int32_t offset_y;
+    uint32_t width;
+    uint32_t height;
+    uint32_t row_words;
+    uint32_t padding;
+    uint64_t population;
+    //In words from the start of the bitmaps
+    uint64_t bitmap_offset;
+} pattern_entry;
+
+typedef struct pattern_library_t{
+    //The whole index, either read from its file or built in memory
+    uint8_t* data;
+    size_t len;
+    bool from_index;
+    //Whether any pattern had to be parsed when the library was opened
+    bool rebuilt;
+    pattern_entry* entries;
+    unsigned int num_patterns;
+    uint32_t* bitmaps;
+} pattern_library;
+
+int open_pattern_library(pattern_library* library, const char* directory);
+void free_pattern_library(pattern_library* library);
+pattern_entry* find_pattern(pattern_library* library, const char* name);
+uint32_t* pattern_bitmap(pattern_library* library, pattern_entry* entry);
+bool pattern_cell(pattern_library* library, pattern_entry* entry, unsigned int x, unsigned int y);
+void stamp_pattern(field_data* field, pattern_library* library, pattern_entry* entry, int64_t x, int64_t y);
+int init_field_pattern(field_data* field, pattern_library* library, const char* name, unsigned int width, unsigned int height, bool edge_wrap, char* rules);
+
+#endif
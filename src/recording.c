@@ -0,0 +1,493 @@
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "recording.h"
+#include "errcode.h"
+
+void* recorder_main(void* arg);
+bool write_block(recorder* rec, recording_block* block);
+unsigned int free_blocks(recorder* rec);
+void queue_active_block(recorder* rec);
+void put_bytes(void* context, const void* bytes, size_t len);
+uint64_t recorder_clock_ns(void);
+int add_key(recording_key** keys, uint64_t* num_keys, uint64_t* capacity, uint64_t generation, uint64_t offset);
+bool read_block_header(recording_player* player, uint64_t offset, recording_block_header* header);
+bool load_block(recording_player* player, uint64_t offset);
+bool read_stream(recording_player* player, void* out, size_t len);
+int fetch_frame(recording_player* player, bool* ended);
+int show_frame(recording_player* player);
+int find_last_frame(recording_player* player);
+int scan_blocks(recording_player* player, uint64_t file_len);
+int read_index(recording_player* player, uint64_t file_len);
+
+//Compresses and writes each block it is handed, so the simulation never waits on the disk
+void* recorder_main(void* arg){
+    recorder* rec = arg;
+    pthread_mutex_lock(&rec->lock);
+    while(true){
+        while(rec->num_writing == 0 && !rec->quit)
+            pthread_cond_wait(&rec->wake, &rec->lock);
+        if(rec->num_writing == 0)
+            break;
+
+        //A block being written is never touched by the simulation until it is handed back
+        recording_block* block = &rec->blocks[rec->next_write];
+        pthread_mutex_unlock(&rec->lock);
+        bool written = write_block(rec, block);
+        block->len = 0;
+        block->key = false;
+        pthread_mutex_lock(&rec->lock);
+        rec->write_failed |= !written;
+        rec->next_write = (rec->next_write + 1) % rec->num_blocks;
+        --rec->num_writing;
+    }
+    pthread_mutex_unlock(&rec->lock);
+    return NULL;
+}
+
+bool write_block(recorder* rec, recording_block* block){
+    //Only kept if it comes out smaller than the block
+    size_t compressed_len = compress_block(block->data, block->len, rec->compressed, block->len - 1);
+    recording_block_header header = {
+        .magic = RECORDING_BLOCK_MAGIC,
+        .flags = (block->key ? RECORDING_BLOCK_KEY : 0) | (compressed_len ? 0 : RECORDING_BLOCK_STORED),
+        .raw_len = block->len,
+        .stored_len = compressed_len ? compressed_len : block->len,
+        .key_generation = block->key ? block->key_generation : 0
+    };
+    //A key frame missing from the index only makes seeking start from the one before it
+    if(block->key)
+        add_key(&rec->keys, &rec->num_keys, &rec->keys_capacity, block->key_generation, rec->file_offset);
+    rec->file_offset += sizeof(header) + header.stored_len;
+
+    //Flushed straight away, so everything handed off is in the file even if the game crashes
+    return fwrite(&header, sizeof(header), 1, rec->fp) == 1
+           && fwrite(compressed_len ? rec->compressed : block->data, 1, header.stored_len, rec->fp) == header.stored_len
+           && fflush(rec->fp) == 0;
+}
+
+//Blocks that can still be filled after the active one
+unsigned int free_blocks(recorder* rec){
+    pthread_mutex_lock(&rec->lock);
+    unsigned int num_free = rec->num_blocks - 1 - rec->num_writing;
+    pthread_mutex_unlock(&rec->lock);
+    return num_free;
+}
+
+//Gives the active block to the writer and starts filling the next one, which has to be free
+void queue_active_block(recorder* rec){
+    pthread_mutex_lock(&rec->lock);
+    ++rec->num_writing;
+    rec->active = (rec->active + 1) % rec->num_blocks;
+    pthread_cond_signal(&rec->wake);
+    pthread_mutex_unlock(&rec->lock);
+    rec->active_frames = 0;
+}
+
+//Adds part of a frame to the stream, moving on to the next block whenever one fills up
+void put_bytes(void* context, const void* bytes, size_t len){
+    recorder* rec = context;
+    const uint8_t* in = bytes;
+    while(len){
+        recording_block* block = &rec->blocks[rec->active];
+        if(block->len == RECORDING_BLOCK_LENGTH){
+            queue_active_block(rec);
+            continue;
+        }
+        if(block->len == 0)
+            rec->active_since_ns = recorder_clock_ns();
+        size_t part = (len < RECORDING_BLOCK_LENGTH - block->len) ? len : RECORDING_BLOCK_LENGTH - block->len;
+        memcpy(block->data + block->len, in, part);
+        block->len += part;
+        in += part;
+        len -= part;
+    }
+}
+
+uint64_t recorder_clock_ns(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+int add_key(recording_key** keys, uint64_t* num_keys, uint64_t* capacity, uint64_t generation, uint64_t offset){
+    if(*num_keys == *capacity){
+        uint64_t grown_capacity = *capacity ? 2 * *capacity : 64;
+        recording_key* grown = realloc(*keys, grown_capacity * sizeof(recording_key));
+        if(grown == NULL)
+            return OUT_OF_MEM;
+        *keys = grown;
+        *capacity = grown_capacity;
+    }
+    (*keys)[(*num_keys)++] = (recording_key) {generation, offset};
+    return NO_ERR;
+}
+
+int init_recorder(recorder* rec, const char* path, field_data* field, unsigned int interval){
+    rec->fp = fopen(path, "wb");
+    if(rec->fp == NULL)
+        return RECORDING_FAIL;
+
+    //Every frame has to fit in the blocks that are free while the writer is idle
+    rec->num_words = field->buffer_r->num_words;
+    uint64_t largest_frame = sizeof(frame_header) + max_encoded_len(rec->num_words);
+    rec->num_blocks = RECORDING_BUFFER_LENGTH / RECORDING_BLOCK_LENGTH;
+    if(rec->num_blocks < (largest_frame + RECORDING_BLOCK_LENGTH - 1) / RECORDING_BLOCK_LENGTH + 1)
+        rec->num_blocks = (largest_frame + RECORDING_BLOCK_LENGTH - 1) / RECORDING_BLOCK_LENGTH + 1;
+    rec->blocks = malloc(rec->num_blocks * sizeof(recording_block));
+    rec->pool = malloc((size_t) rec->num_blocks * RECORDING_BLOCK_LENGTH);
+    rec->compressed = malloc(RECORDING_BLOCK_LENGTH);
+    rec->previous = malloc(rec->num_words * sizeof(uint32_t));
+    rec->keys = NULL;
+    rec->num_keys = rec->keys_capacity = 0;
+    if(rec->blocks == NULL || rec->pool == NULL || rec->compressed == NULL || rec->previous == NULL){
+        free(rec->blocks);
+        free(rec->pool);
+        free(rec->compressed);
+        free(rec->previous);
+        fclose(rec->fp);
+        return OUT_OF_MEM;
+    }
+    for(unsigned int i = 0; i < rec->num_blocks; ++i)
+        rec->blocks[i] = (recording_block) {rec->pool + (size_t) i * RECORDING_BLOCK_LENGTH, 0, false, 0};
+
+    rec->header = (recording_header) {
+        .magic = RECORDING_MAGIC,
+        .version = RECORDING_VERSION,
+        .width = field->size_x,
+        .height = field->size_y,
+        .flags = (field->rules.neighbourhood == HEXAGONAL) ? FRAME_HEXAGONAL : 0,
+        .interval = interval
+    };
+    rec->write_failed = (fwrite(&rec->header, sizeof(rec->header), 1, rec->fp) != 1);
+    rec->file_offset = sizeof(rec->header);
+    rec->active = rec->next_write = rec->num_writing = 0;
+    rec->active_frames = 0;
+    rec->quit = false;
+    rec->needs_key = true;
+    rec->frames_since_key = 0;
+    rec->recorded_frames = rec->skipped_frames = 0;
+
+    pthread_mutex_init(&rec->lock, NULL);
+    pthread_cond_init(&rec->wake, NULL);
+    if(pthread_create(&rec->thread, NULL, recorder_main, rec) != 0){
+        pthread_cond_destroy(&rec->wake);
+        pthread_mutex_destroy(&rec->lock);
+        free(rec->blocks);
+        free(rec->pool);
+        free(rec->compressed);
+        free(rec->previous);
+        fclose(rec->fp);
+        return RECORDING_FAIL;
+    }
+    return NO_ERR;
+}
+
+void record_frame(recorder* rec, field_data* field, uint64_t generation){
+    uint32_t* frame = field->buffer_r->bitmap;
+    bool key = rec->needs_key || rec->frames_since_key == RECORDING_KEY_INTERVAL;
+    uint32_t* previous = key ? NULL : rec->previous;
+    uint64_t len = sizeof(frame_header) + encode_frame_to(frame, previous, rec->num_words, NULL, NULL);
+
+    //Key frames start a block of their own, so the index can point at them
+    recording_block* active = &rec->blocks[rec->active];
+    uint64_t room = (key && active->len) ? 0 : RECORDING_BLOCK_LENGTH - active->len;
+    uint64_t blocks_needed = (len > room) ? (len - room + RECORDING_BLOCK_LENGTH - 1) / RECORDING_BLOCK_LENGTH : 0;
+    if(blocks_needed > free_blocks(rec)){
+        //The frames after this one can not be told apart from the one before it any more
+        rec->needs_key = true;
+        ++rec->skipped_frames;
+        return;
+    }
+
+    if(key && active->len)
+        queue_active_block(rec);
+    if(key){
+        rec->blocks[rec->active].key = true;
+        rec->blocks[rec->active].key_generation = generation;
+    }
+    frame_header header = {
+        .magic = FRAME_MAGIC,
+        .flags = (key ? FRAME_KEY : 0) | rec->header.flags,
+        .width = rec->header.width,
+        .height = rec->header.height,
+        .generation = generation,
+        .payload_len = len - sizeof(frame_header)
+    };
+    put_bytes(rec, &header, sizeof(header));
+    encode_frame_to(frame, previous, rec->num_words, put_bytes, rec);
+    ++rec->active_frames;
+    memcpy(rec->previous, frame, rec->num_words * sizeof(uint32_t));
+
+    rec->needs_key = false;
+    rec->frames_since_key = key ? 1 : rec->frames_since_key + 1;
+    ++rec->recorded_frames;
+
+    //Sparse games would otherwise keep their frames in memory for a long time.  If the writer is
+    //that far behind, the block is just handed off with a later frame
+    active = &rec->blocks[rec->active];
+    if(active->len && (rec->active_frames >= RECORDING_FLUSH_FRAMES || recorder_clock_ns() - rec->active_since_ns >= RECORDING_FLUSH_NS)
+       && free_blocks(rec) > 0)
+        queue_active_block(rec);
+}
+
+//Writes whatever is left, then the index, waiting until it is all on disk
+int free_recorder(recorder* rec){
+    pthread_mutex_lock(&rec->lock);
+    //The writer only needs the block after it if the simulation goes on filling it
+    if(rec->blocks[rec->active].len)
+        ++rec->num_writing;
+    rec->quit = true;
+    pthread_cond_signal(&rec->wake);
+    pthread_mutex_unlock(&rec->lock);
+    pthread_join(rec->thread, NULL);
+
+    recording_trailer trailer = {rec->file_offset, rec->num_keys, RECORDING_MAGIC, 0};
+    bool written = !rec->write_failed
+                   && fwrite(rec->keys, sizeof(recording_key), rec->num_keys, rec->fp) == rec->num_keys
+                   && fwrite(&trailer, sizeof(trailer), 1, rec->fp) == 1;
+    written &= (fclose(rec->fp) == 0);
+
+    pthread_cond_destroy(&rec->wake);
+    pthread_mutex_destroy(&rec->lock);
+    free(rec->blocks);
+    free(rec->pool);
+    free(rec->compressed);
+    free(rec->previous);
+    free(rec->keys);
+    return written ? NO_ERR : RECORDING_FAIL;
+}
+
+bool read_block_header(recording_player* player, uint64_t offset, recording_block_header* header){
+    return offset + sizeof(*header) <= player->frames_end
+           && fseeko(player->fp, offset, SEEK_SET) == 0 && fread(header, sizeof(*header), 1, player->fp) == 1
+           && header->magic == RECORDING_BLOCK_MAGIC && header->raw_len > 0 && header->raw_len <= RECORDING_BLOCK_LENGTH
+           && ((header->flags & RECORDING_BLOCK_STORED) ? header->stored_len == header->raw_len : header->stored_len < header->raw_len)
+           && header->stored_len <= player->frames_end - offset - sizeof(*header);
+}
+
+//Reads and decompresses the block at offset, ready to read from its start
+bool load_block(recording_player* player, uint64_t offset){
+    recording_block_header header;
+    if(!read_block_header(player, offset, &header))
+        return false;
+    bool stored = header.flags & RECORDING_BLOCK_STORED;
+    if(fread(stored ? player->block : player->compressed, header.stored_len, 1, player->fp) != 1
+       || (!stored && decompress_block(player->compressed, header.stored_len, player->block, header.raw_len) != NO_ERR))
+        return false;
+    player->block_offset = offset;
+    player->next_block = offset + sizeof(header) + header.stored_len;
+    player->block_len = header.raw_len;
+    player->block_pos = 0;
+    return true;
+}
+
+//Reads the next len bytes of frames, carrying on into the blocks after this one as needed
+bool read_stream(recording_player* player, void* out, size_t len){
+    uint8_t* dest = out;
+    while(len){
+        if(player->block_pos == player->block_len){
+            if(!load_block(player, player->next_block))
+                return false;
+            continue;
+        }
+        size_t part = (len < player->block_len - player->block_pos) ? len : player->block_len - player->block_pos;
+        memcpy(dest, player->block + player->block_pos, part);
+        player->block_pos += part;
+        dest += part;
+        len -= part;
+    }
+    return true;
+}
+
+//Reads the next frame, unless one is already waiting to be shown.  ended tells whether there was none
+int fetch_frame(recording_player* player, bool* ended){
+    *ended = false;
+    if(player->pending)
+        return NO_ERR;
+    *ended = (player->block_offset == player->end_block && player->block_pos == player->end_pos);
+    if(*ended)
+        return NO_ERR;
+
+    frame_header header;
+    if(!read_stream(player, &header, sizeof(header)) || header.magic != FRAME_MAGIC || header.width != player->header.width
+       || header.height != player->header.height || header.payload_len > max_encoded_len(player->field.buffer_r->num_words))
+        return FRAME_FORMAT_FAIL;
+    if(header.payload_len > player->payload_capacity){
+        uint8_t* grown = realloc(player->payload, header.payload_len);
+        if(grown == NULL)
+            return OUT_OF_MEM;
+        player->payload = grown;
+        player->payload_capacity = header.payload_len;
+    }
+    if(!read_stream(player, player->payload, header.payload_len))
+        return FRAME_FORMAT_FAIL;
+    player->pending_header = header;
+    player->pending = true;
+    return NO_ERR;
+}
+
+//Decodes the frame that was read onto the field
+int show_frame(recording_player* player){
+    player->pending = false;
+    int status = decode_frame(player->payload, player->pending_header.payload_len, player->field.buffer_r->bitmap,
+                              player->field.buffer_r->num_words, player->pending_header.flags & FRAME_KEY);
+    if(status != NO_ERR)
+        return status;
+    invalidate_field_stats(&player->field);
+    player->generation = player->pending_header.generation;
+    return NO_ERR;
+}
+
+//Reads on from the last key frame to find where the last whole frame ends.  A key frame that was
+//cut short is dropped from the index
+int find_last_frame(recording_player* player){
+    player->end_block = UINT64_MAX;
+    while(player->num_keys){
+        bool found = false, ended;
+        uint64_t end_block = 0;
+        size_t end_pos = 0;
+        int status = load_block(player, player->keys[player->num_keys - 1].offset) ? NO_ERR : FRAME_FORMAT_FAIL;
+        player->pending = false;
+        while(status == NO_ERR && (status = fetch_frame(player, &ended)) == NO_ERR){
+            player->pending = false;
+            found = true;
+            player->last_generation = player->pending_header.generation;
+            end_block = player->block_offset;
+            end_pos = player->block_pos;
+        }
+        if(status == OUT_OF_MEM)
+            return status;
+        if(found){
+            player->end_block = end_block;
+            player->end_pos = end_pos;
+            return NO_ERR;
+        }
+        --player->num_keys;
+    }
+    return FRAME_FORMAT_FAIL;
+}
+
+//Finds the key frames of a recording that was never finished, up to the last block that is whole
+int scan_blocks(recording_player* player, uint64_t file_len){
+    uint64_t capacity = 0;
+    uint64_t offset = sizeof(recording_header);
+    recording_block_header header;
+    player->frames_end = file_len;
+    while(read_block_header(player, offset, &header)){
+        if((header.flags & RECORDING_BLOCK_KEY) && add_key(&player->keys, &player->num_keys, &capacity, header.key_generation, offset) != NO_ERR)
+            return OUT_OF_MEM;
+        offset += sizeof(header) + header.stored_len;
+    }
+    player->frames_end = offset;
+    return NO_ERR;
+}
+
+//Reads the index at the end of a finished recording.  Returns FRAME_FORMAT_FAIL if it has none
+int read_index(recording_player* player, uint64_t file_len){
+    recording_trailer trailer;
+    if(file_len < sizeof(recording_header) + sizeof(trailer)
+       || fseeko(player->fp, file_len - sizeof(trailer), SEEK_SET) != 0 || fread(&trailer, sizeof(trailer), 1, player->fp) != 1
+       || trailer.magic != RECORDING_MAGIC || trailer.index_offset < sizeof(recording_header)
+       || trailer.num_keys > (file_len - sizeof(trailer) - trailer.index_offset) / sizeof(recording_key)
+       || trailer.index_offset + trailer.num_keys * sizeof(recording_key) + sizeof(trailer) != file_len)
+        return FRAME_FORMAT_FAIL;
+
+    player->keys = malloc((trailer.num_keys ? trailer.num_keys : 1) * sizeof(recording_key));
+    if(player->keys == NULL)
+        return OUT_OF_MEM;
+    if(fseeko(player->fp, trailer.index_offset, SEEK_SET) != 0 || fread(player->keys, sizeof(recording_key), trailer.num_keys, player->fp) != trailer.num_keys){
+        free(player->keys);
+        player->keys = NULL;
+        return FRAME_FORMAT_FAIL;
+    }
+    player->num_keys = trailer.num_keys;
+    player->frames_end = trailer.index_offset;
+    return NO_ERR;
+}
+
+int open_recording(recording_player* player, const char* path){
+    player->fp = fopen(path, "rb");
+    if(player->fp == NULL)
+        return FILE_NOT_FOUND;
+    player->keys = NULL;
+    player->num_keys = 0;
+    player->payload = NULL;
+    player->payload_capacity = 0;
+    player->pending = false;
+
+    if(fread(&player->header, sizeof(player->header), 1, player->fp) != 1 || player->header.magic != RECORDING_MAGIC
+       || player->header.version != RECORDING_VERSION || player->header.width == 0 || player->header.height == 0){
+        fclose(player->fp);
+        return FRAME_FORMAT_FAIL;
+    }
+    player->block = malloc(RECORDING_BLOCK_LENGTH);
+    player->compressed = malloc(RECORDING_BLOCK_LENGTH);
+    int status = (player->block && player->compressed) ? NO_ERR : OUT_OF_MEM;
+    if(status == NO_ERR)
+        status = init_field(&player->field, player->header.width, player->header.height, 0, false, NULL);
+    if(status != NO_ERR){
+        free(player->block);
+        free(player->compressed);
+        fclose(player->fp);
+        return status;
+    }
+    player->field.rules.neighbourhood = (player->header.flags & FRAME_HEXAGONAL) ? HEXAGONAL : MOORE;
+
+    fseeko(player->fp, 0, SEEK_END);
+    uint64_t file_len = ftello(player->fp);
+    status = read_index(player, file_len);
+    if(status == FRAME_FORMAT_FAIL)
+        status = scan_blocks(player, file_len);
+    player->last_generation = 0;
+    if(status == NO_ERR)
+        status = find_last_frame(player);
+    if(status == NO_ERR)
+        status = seek_recording(player, 0);
+    if(status != NO_ERR)
+        close_recording(player);
+    return status;
+}
+
+//Moves on to the next recorded frame.  ended tells whether there was none
+int next_recorded_frame(recording_player* player, bool* ended){
+    int status = fetch_frame(player, ended);
+    return (status != NO_ERR || *ended) ? status : show_frame(player);
+}
+
+//Shows the last frame recorded at or before generation, or the first frame if there is none
+int seek_recording(recording_player* player, uint64_t generation){
+    uint64_t low = 0, high = player->num_keys;
+    while(high - low > 1){
+        uint64_t middle = low + (high - low) / 2;
+        if(player->keys[middle].generation <= generation)
+            low = middle;
+        else
+            high = middle;
+    }
+
+    if(!load_block(player, player->keys[low].offset))
+        return FRAME_FORMAT_FAIL;
+    player->pending = false;
+    bool ended;
+    int status = fetch_frame(player, &ended);
+    if(status == NO_ERR && (ended || !(player->pending_header.flags & FRAME_KEY)))
+        status = FRAME_FORMAT_FAIL;
+    if(status == NO_ERR)
+        status = show_frame(player);
+    while(status == NO_ERR && (status = fetch_frame(player, &ended)) == NO_ERR && !ended && player->pending_header.generation <= generation)
+        status = show_frame(player);
+    return status;
+}
+
+void close_recording(recording_player* player){
+    free_field(&player->field);
+    free(player->keys);
+    free(player->payload);
+    free(player->block);
+    free(player->compressed);
+    fclose(player->fp);
+}
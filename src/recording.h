@@ -0,0 +1,148 @@
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include <stdio.h>
+#include <pthread.h>
+
+#include "gamefield.h"
+#include "frame_codec.h"
+
+#define RECORDING_MAGIC 0x4345524CU
+#define RECORDING_BLOCK_MAGIC 0x4B4C424CU
+#define RECORDING_VERSION 2
+//Every this many recorded frames is a key frame, which is as far as seeking has to read from
+#define RECORDING_KEY_INTERVAL 64
+//Frames are written as one stream, cut into blocks of up to this many bytes that are compressed
+//one at a time.  A frame carries on into the next block if it does not fit
+#define RECORDING_BLOCK_LENGTH (64 * 1024)
+//Blocks waiting for the writer take up this much memory, or enough for the largest frame of the
+//field if that is more
+#define RECORDING_BUFFER_LENGTH (4 * 1024 * 1024)
+//A block is also written once it holds this many frames, or its first frame is this old, so a
+//game that crashes leaves a recording that plays up to shortly before the crash
+#define RECORDING_FLUSH_FRAMES 64
+#define RECORDING_FLUSH_NS 1000000000ULL
+//The block starts with a key frame
+#define RECORDING_BLOCK_KEY 0b1
+//The block did not get any smaller by compressing it, so it is stored as it is
+#define RECORDING_BLOCK_STORED 0b10
+
+//Starts every recording.  It is followed by blocks holding frames in the same format broadcasts
+//use, then the index of key frames, then the trailer
+typedef struct recording_header_t{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t flags;
+    //Generations between recorded frames
+    uint32_t interval;
+} recording_header;
+
+//Written in front of every block
+typedef struct recording_block_header_t{
+    uint32_t magic;
+    uint32_t flags;
+    uint32_t raw_len;
+    uint32_t stored_len;
+    //Generation of the key frame the block starts with, if it starts with one
+    uint64_t key_generation;
+} recording_block_header;
+
+//Key frames always start a block, so offset is where that block is in the file
+typedef struct recording_key_t{
+    uint64_t generation;
+    uint64_t offset;
+} recording_key;
+
+//Ends a finished recording.  A recording without one was cut short, and its blocks are scanned instead
+typedef struct recording_trailer_t{
+    uint64_t index_offset;
+    uint64_t num_keys;
+    uint32_t magic;
+    uint32_t padding;
+} recording_trailer;
+
+typedef struct recording_block_t{
+    uint8_t* data;
+    size_t len;
+    bool key;
+    uint64_t key_generation;
+} recording_block;
+
+//Frames are encoded into one block while a thread compresses the others and writes them to disk,
+//in the order they were filled.  Recording never waits for the disk: a frame that does not fit in
+//the blocks that are free is skipped, and the next frame is a key frame in its place
+typedef struct recorder_t{
+    FILE* fp;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    recording_block* blocks;
+    unsigned int num_blocks;
+    uint8_t* pool;
+    //Where the writer compresses a block
+    uint8_t* compressed;
+    //The block frames are encoded into, how many frames it holds and since when
+    unsigned int active;
+    unsigned int active_frames;
+    uint64_t active_since_ns;
+    //Blocks handed to the writer, starting with the one it writes next
+    unsigned int next_write;
+    unsigned int num_writing;
+    bool write_failed;
+    bool quit;
+    //Bytes of the file written so far.  Along with the index it belongs to the writer
+    uint64_t file_offset;
+    recording_header header;
+    uint32_t* previous;
+    uint64_t num_words;
+    bool needs_key;
+    uint64_t frames_since_key;
+    recording_key* keys;
+    uint64_t num_keys;
+    uint64_t keys_capacity;
+    uint64_t recorded_frames;
+    //Frames left out because the disk fell behind
+    uint64_t skipped_frames;
+} recorder;
+
+//Plays a recording back from any generation in it
+typedef struct recording_player_t{
+    FILE* fp;
+    recording_header header;
+    recording_key* keys;
+    uint64_t num_keys;
+    //Where the blocks end and the index starts
+    uint64_t frames_end;
+    //The block being read, where the one after it starts, and how much of it is read
+    uint64_t block_offset;
+    uint64_t next_block;
+    uint8_t* block;
+    uint8_t* compressed;
+    size_t block_len;
+    size_t block_pos;
+    //Where the last whole frame ends
+    uint64_t end_block;
+    size_t end_pos;
+    //The next frame, read but not shown yet
+    bool pending;
+    frame_header pending_header;
+    uint8_t* payload;
+    size_t payload_capacity;
+    field_data field;
+    uint64_t generation;
+    //Generation of the last frame in the recording
+    uint64_t last_generation;
+} recording_player;
+
+int init_recorder(recorder* rec, const char* path, field_data* field, unsigned int interval);
+void record_frame(recorder* rec, field_data* field, uint64_t generation);
+int free_recorder(recorder* rec);
+
+int open_recording(recording_player* player, const char* path);
+int next_recorded_frame(recording_player* player, bool* ended);
+int seek_recording(recording_player* player, uint64_t generation);
+void close_recording(recording_player* player);
+
+#endif
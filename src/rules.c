@@ -4,9 +4,14 @@
 #include "errcode.h"
 
 #define RULE_SEPARATOR_CHAR '/'
+//Suffixes that pick a neighbourhood other than the default Moore one, eg "2/24H"
+#define HEXAGONAL_CHAR 'H'
+#define VON_NEUMANN_CHAR 'V'
 #define RULE_SEPARATOR_CONST -1
 #define CHAR_IGNORE_CONST -2
 #define INVALID_CHAR -3
+#define HEXAGONAL_CONST -4
+#define VON_NEUMANN_CONST -5
 
 int char_to_int(char c){
     switch(c){
@@ -30,6 +35,12 @@ int char_to_int(char c){
         return 8;
     case RULE_SEPARATOR_CHAR:
         return RULE_SEPARATOR_CONST;
+    case HEXAGONAL_CHAR:
+    case 'h':
+        return HEXAGONAL_CONST;
+    case VON_NEUMANN_CHAR:
+    case 'v':
+        return VON_NEUMANN_CONST;
     }
 
     if(isspace(c))
@@ -43,6 +54,8 @@ int parse_rules(rule_set* rule_set, char* rule_string){
     for(int i = 0; i < NUM_RULES; ++i){
         rule_set->rules[i] = DIE;
     }
+    rule_set->neighbourhood = MOORE;
+    bool read_suffix = false;
     //Any numbers we read before a '/' are how many neighbors a live cell needs to stay alive
     enum rule_type rule_bucket = KEEP_ALIVE;
 
@@ -57,7 +70,16 @@ int parse_rules(rule_set* rule_set, char* rule_string){
         if(parsed_char == CHAR_IGNORE_CONST)
             continue;
 
-        if(parsed_char == RULE_SEPARATOR_CONST){
+        //The neighbourhood suffix comes last, after the born counts
+        if(read_suffix)
+            return RULE_PARSE_FAIL;
+
+        if(parsed_char == HEXAGONAL_CONST || parsed_char == VON_NEUMANN_CONST){
+            if(rule_bucket != BE_BORN)
+                return RULE_PARSE_FAIL;
+            rule_set->neighbourhood = (parsed_char == HEXAGONAL_CONST) ? HEXAGONAL : VON_NEUMANN;
+            read_suffix = true;
+        }else if(parsed_char == RULE_SEPARATOR_CONST){
             //After the '/', a number means how many neighbors a cell must have to be born
             if(rule_bucket == KEEP_ALIVE)
                 rule_bucket = BE_BORN;
@@ -68,9 +90,26 @@ int parse_rules(rule_set* rule_set, char* rule_string){
             rule_set->rules[parsed_char] |= rule_bucket;
         }
     }
+
+    //Smaller neighbourhoods can not have as many live neighbours
+    for(int i = neighbourhood_size(rule_set->neighbourhood) + 1; i < NUM_RULES; ++i){
+        if(rule_set->rules[i] != DIE)
+            return RULE_PARSE_FAIL;
+    }
     return NO_ERR;
 }
 
+int neighbourhood_size(enum neighbourhood neighbourhood){
+    switch(neighbourhood){
+    case HEXAGONAL:
+        return 6;
+    case VON_NEUMANN:
+        return 4;
+    default:
+        return 8;
+    }
+}
+
 bool next_cell_state(rule_set* rule_set, bool cell_state, int num_neighbours){
     if(num_neighbours < 0 || num_neighbours >= NUM_RULES)
         return false;
@@ -85,3 +124,21 @@ bool next_cell_state(rule_set* rule_set, bool cell_state, int num_neighbours){
 
     return false;
 }
+
+void rules_to_string(rule_set* rule_set, char* rule_string){
+    char* p = rule_string;
+    for(int i = 0; i < NUM_RULES; ++i){
+        if(rule_set->rules[i] & KEEP_ALIVE)
+            *p++ = '0' + i;
+    }
+    *p++ = RULE_SEPARATOR_CHAR;
+    for(int i = 0; i < NUM_RULES; ++i){
+        if(rule_set->rules[i] & BE_BORN)
+            *p++ = '0' + i;
+    }
+    if(rule_set->neighbourhood == HEXAGONAL)
+        *p++ = HEXAGONAL_CHAR;
+    else if(rule_set->neighbourhood == VON_NEUMANN)
+        *p++ = VON_NEUMANN_CHAR;
+    *p = '\0';
+}
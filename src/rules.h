@@ -5,6 +5,9 @@
 
 //A cell can have 0 to 8 living neighbors
 #define NUM_RULES 9
+//Longest rule string we produce: every neighbour count on both sides of the '/', the
+//neighbourhood suffix and the terminator
+#define RULE_STRING_LENGTH (2 * NUM_RULES + 3)
 
 enum rule_type{
     DIE = 0b00,
@@ -12,11 +15,23 @@ enum rule_type{
     BE_BORN = 0b01
 };
 
+//Which cells count as neighbours.  Hexagonal fields use offset rows: every odd row sits half a
+//cell to the right of the even rows, so a cell's neighbours above and below it are the two
+//cells that overlap it
+enum neighbourhood{
+    MOORE = 0,
+    HEXAGONAL,
+    VON_NEUMANN
+};
+
 typedef struct ruleset_t{
     enum rule_type rules[NUM_RULES];
+    enum neighbourhood neighbourhood;
 } rule_set;
 
 int parse_rules(rule_set* rules, char* rule_string);
 bool next_cell_state(rule_set* rules, bool cell_state, int num_neighbours);
+void rules_to_string(rule_set* rules, char* rule_string);
+int neighbourhood_size(enum neighbourhood neighbourhood);
 
 #endif
@@ -0,0 +1,296 @@
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+
+#include "shard.h"
+#include "errcode.h"
+
+#define SHM_NAME_LENGTH 64
+//Keep the frame and halo rings off the cache lines holding the semaphores
+#define SHM_ALIGNMENT 64
+//While waiting on the workers, check this often that none of them has died
+#define WORKER_CHECK_NS 100000000L
+
+enum shard_edge{
+    TOP_EDGE = 0,
+    BOTTOM_EDGE,
+    NUM_EDGES
+};
+
+//Each worker waits on its own start semaphore for the next generation, and posts done once it
+//has finished it.  The coordinator only starts a generation once every worker is done with the
+//last one, so no worker reads a halo slot while another one writes it
+struct shard_control_t{
+    sem_t start[MAX_SHARDS];
+    sem_t done;
+    int quit;
+    int failed;
+    unsigned int row_words;
+};
+
+size_t align_up(size_t len);
+uint32_t* halo_row(shard_sim* sim, unsigned int shard, enum shard_edge edge, unsigned int slot);
+void publish_edges(shard_sim* sim, field_data* shard, unsigned int index, unsigned int slot);
+void load_halos(shard_sim* sim, field_data* shard, unsigned int index, unsigned int slot, bool edge_wrap);
+void run_worker(shard_sim* sim, field_data* field, unsigned int index, pid_t coordinator);
+void stop_workers(shard_sim* sim, unsigned int num_started);
+bool workers_alive(shard_sim* sim);
+int wait_for_workers(shard_sim* sim);
+void start_workers(shard_sim* sim);
+void release_shards(shard_sim* sim);
+
+size_t align_up(size_t len){
+    return (len + SHM_ALIGNMENT - 1) & ~((size_t) SHM_ALIGNMENT - 1);
+}
+
+uint32_t* halo_row(shard_sim* sim, unsigned int shard, enum shard_edge edge, unsigned int slot){
+    unsigned int row_words = sim->control->row_words;
+    return sim->halos + (size_t) ((((shard * NUM_EDGES) + edge) * HALO_SLOTS) + slot) * row_words;
+}
+
+void publish_edges(shard_sim* sim, field_data* shard, unsigned int index, unsigned int slot){
+    size_t row_bytes = shard->row_words * sizeof(uint32_t);
+    memcpy(halo_row(sim, index, TOP_EDGE, slot), field_row(shard, shard->buffer_r, 1), row_bytes);
+    memcpy(halo_row(sim, index, BOTTOM_EDGE, slot), field_row(shard, shard->buffer_r, shard->size_y - 2), row_bytes);
+}
+
+void load_halos(shard_sim* sim, field_data* shard, unsigned int index, unsigned int slot, bool edge_wrap){
+    size_t row_bytes = shard->row_words * sizeof(uint32_t);
+    unsigned int num_shards = sim->num_shards;
+    uint32_t* top = field_row(shard, shard->buffer_r, 0);
+    uint32_t* bottom = field_row(shard, shard->buffer_r, shard->size_y - 1);
+
+    //Without edge wrapping, the rows beyond the top and bottom of the universe are always dead
+    if(index == 0 && !edge_wrap)
+        memset(top, 0, row_bytes);
+    else
+        memcpy(top, halo_row(sim, (index + num_shards - 1) % num_shards, BOTTOM_EDGE, slot), row_bytes);
+
+    if(index == num_shards - 1 && !edge_wrap)
+        memset(bottom, 0, row_bytes);
+    else
+        memcpy(bottom, halo_row(sim, (index + 1) % num_shards, TOP_EDGE, slot), row_bytes);
+}
+
+void run_worker(shard_sim* sim, field_data* field, unsigned int index, pid_t coordinator){
+    //Never outlive the coordinator, or we would wait for the next generation forever.  If it died
+    //before the signal was asked for, no signal is coming
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    if(getppid() != coordinator)
+        _exit(EXIT_ERR);
+
+    shard_control* control = sim->control;
+    unsigned int first = sim->first_row[index];
+    unsigned int rows = sim->first_row[index + 1] - first;
+    size_t row_bytes = field->row_words * sizeof(uint32_t);
+
+    //A shard holds its own rows plus one halo row above and below them
+    field_data shard;
+    if(init_field(&shard, field->size_x, rows + 2, 0, field->edge_wrap, NULL) != NO_ERR){
+        control->failed = 1;
+        sem_post(&control->done);
+        _exit(EXIT_ERR);
+    }
+    shard.rules = field->rules;
+    shard.row_origin = first - 1;
+    memcpy(field_row(&shard, shard.buffer_r, 1), field_row(field, field->buffer_r, first), rows * row_bytes);
+    publish_edges(sim, &shard, index, 0);
+    sem_post(&control->done);
+
+    for(unsigned int generation = 0; ; ++generation){
+        //Wait for the coordinator to ask for the next generation
+        while(sem_wait(&control->start[index]) != 0);
+        if(control->quit)
+            break;
+
+        load_halos(sim, &shard, index, generation % HALO_SLOTS, field->edge_wrap);
+        update_rows(&shard, 1, rows);
+        swap_buffers(&shard);
+        publish_edges(sim, &shard, index, (generation + 1) % HALO_SLOTS);
+        memcpy(sim->frame + ((size_t) first * field->row_words), field_row(&shard, shard.buffer_r, 1), rows * row_bytes);
+        sem_post(&control->done);
+    }
+
+    free_field(&shard);
+    _exit(NO_ERR);
+}
+
+//Workers that were already reaped have a pid of 0, and must not be signalled again
+void stop_workers(shard_sim* sim, unsigned int num_started){
+    for(unsigned int i = 0; i < num_started; ++i){
+        if(sim->workers[i] == 0)
+            continue;
+        kill(sim->workers[i], SIGKILL);
+        waitpid(sim->workers[i], NULL, 0);
+        sim->workers[i] = 0;
+    }
+}
+
+//Reaps any worker that has exited, since a worker only ever exits when it is told to quit
+bool workers_alive(shard_sim* sim){
+    bool alive = true;
+    for(unsigned int i = 0; i < sim->num_shards; ++i){
+        if(sim->workers[i] != 0 && waitpid(sim->workers[i], NULL, WNOHANG) != 0){
+            sim->workers[i] = 0;
+            alive = false;
+        }
+    }
+    return alive;
+}
+
+//Waits for every worker to post done once.  A worker that crashed or was killed never will, so
+//the wait fails once one of them is gone instead of hanging
+int wait_for_workers(shard_sim* sim){
+    for(unsigned int finished = 0; finished < sim->num_shards;){
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += WORKER_CHECK_NS;
+        if(deadline.tv_nsec >= 1000000000L){
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        if(sem_timedwait(&sim->control->done, &deadline) == 0){
+            ++finished;
+            continue;
+        }
+        if((errno != ETIMEDOUT && errno != EINTR) || !workers_alive(sim))
+            return SHARD_INIT_FAIL;
+    }
+    return NO_ERR;
+}
+
+void start_workers(shard_sim* sim){
+    for(unsigned int i = 0; i < sim->num_shards; ++i)
+        sem_post(&sim->control->start[i]);
+}
+
+//Kills whatever workers are left and unmaps the shared memory.  The simulation can not be used afterwards
+void release_shards(shard_sim* sim){
+    stop_workers(sim, sim->num_shards);
+    for(unsigned int i = 0; i < sim->num_shards; ++i)
+        sem_destroy(&sim->control->start[i]);
+    sem_destroy(&sim->control->done);
+    munmap(sim->control, sim->shm_len);
+    sim->control = NULL;
+}
+
+int init_shards(shard_sim* sim, field_data* field, unsigned int num_shards){
+    if(num_shards > field->size_y)
+        num_shards = field->size_y;
+    if(num_shards > MAX_SHARDS)
+        num_shards = MAX_SHARDS;
+    if(num_shards < 1)
+        num_shards = 1;
+
+    sim->num_shards = num_shards;
+    sim->generation = 0;
+    for(unsigned int i = 0; i <= num_shards; ++i)
+        sim->first_row[i] = (i * field->size_y) / num_shards;
+
+    size_t row_bytes = field->row_words * sizeof(uint32_t);
+    size_t control_len = align_up(sizeof(shard_control));
+    size_t frame_len = align_up((size_t) field->size_y * row_bytes);
+    size_t halos_len = (size_t) num_shards * NUM_EDGES * HALO_SLOTS * row_bytes;
+    sim->shm_len = control_len + frame_len + halos_len;
+
+    char shm_name[SHM_NAME_LENGTH];
+    snprintf(shm_name, SHM_NAME_LENGTH, "/lifegame-shards-%i", (int) getpid());
+    int fd = shm_open(shm_name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if(fd < 0)
+        return SHARD_INIT_FAIL;
+    //The mapping stays valid for us and our children after the name is gone
+    shm_unlink(shm_name);
+
+    if(ftruncate(fd, sim->shm_len) != 0){
+        close(fd);
+        return SHARD_INIT_FAIL;
+    }
+    void* shm = mmap(NULL, sim->shm_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(shm == MAP_FAILED)
+        return SHARD_INIT_FAIL;
+
+    sim->control = shm;
+    sim->frame = (uint32_t*) ((char*) shm + control_len);
+    sim->halos = (uint32_t*) ((char*) shm + control_len + frame_len);
+    sim->control->quit = 0;
+    sim->control->failed = 0;
+    sim->control->row_words = field->row_words;
+
+    bool semaphores_ready = sem_init(&sim->control->done, 1, 0) == 0;
+    for(unsigned int i = 0; i < num_shards; ++i)
+        semaphores_ready = semaphores_ready && sem_init(&sim->control->start[i], 1, 0) == 0;
+    if(!semaphores_ready){
+        munmap(shm, sim->shm_len);
+        sim->control = NULL;
+        return SHARD_INIT_FAIL;
+    }
+
+    //Everything reads the field from the frame from now on, and the workers start from it too
+    memcpy(sim->frame, field->buffer_r->bitmap, (size_t) field->size_y * row_bytes);
+    pid_t coordinator = getpid();
+    for(unsigned int i = 0; i < num_shards; ++i)
+        sim->workers[i] = 0;
+    for(unsigned int i = 0; i < num_shards; ++i){
+        pid_t pid = fork();
+        if(pid < 0){
+            release_shards(sim);
+            return SHARD_INIT_FAIL;
+        }
+        if(pid == 0)
+            run_worker(sim, field, i, coordinator);
+        sim->workers[i] = pid;
+    }
+
+    //Wait until every worker has copied its rows out of the field
+    int status = wait_for_workers(sim);
+    if(status == NO_ERR && sim->control->failed)
+        status = OUT_OF_MEM;
+    if(status != NO_ERR){
+        release_shards(sim);
+        return status;
+    }
+
+    //The coordinator keeps no generations of its own.  Drawing, checkpoints and the rest read
+    //the frame the workers write, and only when they need it
+    view_field_bitmap(field, sim->frame);
+    return NO_ERR;
+}
+
+//Fails if a worker died, after which the other workers are stopped.  The field can still be read
+//until free_shards unmaps the frame
+int shard_step(shard_sim* sim, field_data* field){
+    if(sim->control->failed)
+        return SHARD_INIT_FAIL;
+    start_workers(sim);
+    if(wait_for_workers(sim) != NO_ERR){
+        sim->control->failed = 1;
+        stop_workers(sim, sim->num_shards);
+        return SHARD_INIT_FAIL;
+    }
+    invalidate_field_stats(field);
+    ++sim->generation;
+    return NO_ERR;
+}
+
+void free_shards(shard_sim* sim){
+    if(sim->control == NULL)
+        return;
+    sim->control->quit = 1;
+    start_workers(sim);
+    for(unsigned int i = 0; i < sim->num_shards; ++i){
+        if(sim->workers[i] != 0)
+            waitpid(sim->workers[i], NULL, 0);
+        sim->workers[i] = 0;
+    }
+    release_shards(sim);
+}
@@ -0,0 +1,31 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <sys/types.h>
+
+#include "gamefield.h"
+
+//Each shard publishes its edge rows for two generations: the one being read and the one being written
+#define HALO_SLOTS 2
+//The field is never split into more shards than this
+#define MAX_SHARDS 64
+
+typedef struct shard_control_t shard_control;
+
+typedef struct shard_sim_t{
+    shard_control* control;
+    size_t shm_len;
+    uint32_t* frame;
+    uint32_t* halos;
+
+    unsigned int num_shards;
+    unsigned int first_row[MAX_SHARDS + 1];
+    pid_t workers[MAX_SHARDS];
+    unsigned int generation;
+} shard_sim;
+
+int init_shards(shard_sim* sim, field_data* field, unsigned int num_shards);
+int shard_step(shard_sim* sim, field_data* field);
+void free_shards(shard_sim* sim);
+
+#endif
@@ -0,0 +1,100 @@
+#include "step_engines.h"
+#include "kernels.h"
+#include "temporal_block.h"
+#include "errcode.h"
+
+int step_per_cell(engine_run* run, unsigned int generations);
+int step_full(engine_run* run, unsigned int generations);
+int step_word_kernel(engine_run* run, unsigned int generations);
+int step_generic_kernel(engine_run* run, unsigned int generations);
+int step_blocked(engine_run* run, unsigned int generations);
+int start_sharded(engine_run* run);
+int step_sharded(engine_run* run, unsigned int generations);
+void stop_sharded(engine_run* run);
+
+const step_engine STEP_ENGINES[] = {
+    {"per-cell", NULL, step_per_cell, NULL},
+    {"full-step", NULL, step_full, NULL},
+    {"word-kernel", NULL, step_word_kernel, NULL},
+    {"generic-kernel", NULL, step_generic_kernel, NULL},
+    {"blocked", NULL, step_blocked, NULL},
+    {"sharded", start_sharded, step_sharded, stop_sharded},
+    {NULL, NULL, NULL, NULL}
+};
+
+int step_per_cell(engine_run* run, unsigned int generations){
+    for(unsigned int generation = 0; generation < generations; ++generation){
+        update_rows_per_cell(run->field, 0, run->field->size_y - 1);
+        swap_buffers(run->field);
+    }
+    return NO_ERR;
+}
+
+//Specialized kernels, skipping empty rows and frozen tiles, as the game itself steps
+int step_full(engine_run* run, unsigned int generations){
+    for(unsigned int generation = 0; generation < generations; ++generation)
+        update_and_swap_fields(run->field);
+    return NO_ERR;
+}
+
+//Every row with the kernel for the field's rules
+int step_word_kernel(engine_run* run, unsigned int generations){
+    for(unsigned int generation = 0; generation < generations; ++generation){
+        update_rows(run->field, 0, run->field->size_y - 1);
+        swap_buffers(run->field);
+    }
+    return NO_ERR;
+}
+
+//Every row with the kernel rules fall back on when they have no specialized one
+int step_generic_kernel(engine_run* run, unsigned int generations){
+    field_data* field = run->field;
+    for(unsigned int generation = 0; generation < generations; ++generation){
+        invalidate_field_stats(field);
+        for(unsigned int y = 0; y < field->size_y; ++y){
+            uint32_t* above = (y > 0) ? field_row(field, field->buffer_r, y - 1) : field->edge_wrap ? field_row(field, field->buffer_r, field->size_y - 1) : NULL;
+            uint32_t* below = (y + 1 < field->size_y) ? field_row(field, field->buffer_r, y + 1) : field->edge_wrap ? field_row(field, field->buffer_r, 0) : NULL;
+            step_row(NULL, &field->rules, above, field_row(field, field->buffer_r, y), below, field_row(field, field->buffer_w, y),
+                     0, field->row_words, field->row_words, field->size_x, field->edge_wrap, is_odd_row(field, y), NULL);
+        }
+        swap_buffers(field);
+    }
+    return NO_ERR;
+}
+
+int step_blocked(engine_run* run, unsigned int generations){
+    return update_fields_blocked(run->field, generations, ENGINE_BLOCK_DEPTH);
+}
+
+int start_sharded(engine_run* run){
+    return init_shards(&run->shards, run->field, ENGINE_SHARDS);
+}
+
+int step_sharded(engine_run* run, unsigned int generations){
+    for(unsigned int generation = 0; generation < generations; ++generation){
+        int status = shard_step(&run->shards, run->field);
+        if(status != NO_ERR)
+            return status;
+    }
+    return NO_ERR;
+}
+
+void stop_sharded(engine_run* run){
+    free_shards(&run->shards);
+}
+
+//The field must keep its size and rules until the engine is stopped.  A sharded engine leaves it
+//reading from the workers' frame, so once that engine is stopped the field can only be freed
+int start_engine(const step_engine* engine, engine_run* run, field_data* field){
+    run->field = field;
+    return engine->start ? engine->start(run) : NO_ERR;
+}
+
+int run_engine(const step_engine* engine, engine_run* run, unsigned int generations){
+    return engine->step(run, generations);
+}
+
+void stop_engine(const step_engine* engine, engine_run* run){
+    if(engine->stop)
+        engine->stop(run);
+}
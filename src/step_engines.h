@@ -0,0 +1,34 @@
+#ifndef STEP_ENGINES_H
+#define STEP_ENGINES_H
+
+#include "gamefield.h"
+#include "shard.h"
+
+//Shards the sharded engine splits a field into
+#define ENGINE_SHARDS 3
+//Generations the temporal blocking engine advances at once
+#define ENGINE_BLOCK_DEPTH 4
+
+//One field being advanced by an engine, with whatever the engine keeps between calls
+typedef struct engine_run_t{
+    field_data* field;
+    shard_sim shards;
+} engine_run;
+
+//A way of advancing a field.  start and stop may be NULL for engines that keep nothing between calls
+typedef struct step_engine_t{
+    const char* name;
+    int (*start)(engine_run* run);
+    int (*step)(engine_run* run, unsigned int generations);
+    void (*stop)(engine_run* run);
+} step_engine;
+
+//Every engine that can advance a field, ending with an entry whose name is NULL.  The first one
+//steps each cell on its own with count_neighbours, and every other one has to match it bit for bit
+extern const step_engine STEP_ENGINES[];
+
+int start_engine(const step_engine* engine, engine_run* run, field_data* field);
+int run_engine(const step_engine* engine, engine_run* run, unsigned int generations);
+void stop_engine(const step_engine* engine, engine_run* run);
+
+#endif
@@ -0,0 +1,367 @@
+#define _GNU_SOURCE
+
+#include <inttypes.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "sweep.h"
+#include "gamefield.h"
+#include "errcode.h"
+
+#define LIST_SEPARATOR ','
+#define RANGE_SEPARATOR '-'
+#define LIST_INITIAL_LENGTH 16
+
+typedef struct sweep_job_t{
+    char* rule;
+    unsigned int seed_rate;
+    unsigned long random_seed;
+} sweep_job;
+
+typedef struct sweep_result_t{
+    int status;
+    field_stats start;
+    field_stats end;
+    unsigned int generations;
+    //The first generation of the cycle the run settled into, or -1 if it never settled
+    int stable_generation;
+    unsigned int period;
+    uint64_t* curve;
+    unsigned int curve_len;
+} sweep_result;
+
+//Every worker owns a range of jobs.  It takes work from the back of its own range,
+//and once that is empty it steals from the front of the other workers' ranges
+typedef struct job_queue_t{
+    pthread_mutex_t lock;
+    unsigned int top;
+    unsigned int bottom;
+} job_queue;
+
+//Rows are written to config->out as soon as their run finishes, so they come out in no particular order
+typedef struct sweep_state_t{
+    sweep_config* config;
+    sweep_job* jobs;
+    job_queue* queues;
+    unsigned int num_queues;
+    unsigned int curve_step;
+    //Held while a row is written, and guards status
+    pthread_mutex_t out_lock;
+    //The first error any run failed with
+    int status;
+} sweep_state;
+
+//Every worker reuses one result, and its curve, for each run it does
+typedef struct sweep_worker_t{
+    sweep_state* state;
+    unsigned int index;
+    sweep_result result;
+    pthread_t thread;
+} sweep_worker;
+
+int parse_number_list(char* spec, unsigned long** values, unsigned int* count);
+int split_rule_list(char* spec, char*** rules, unsigned int* count);
+uint64_t hash_field(field_data* field);
+void run_job(sweep_state* state, sweep_job* job, sweep_result* result);
+bool take_job(sweep_state* state, unsigned int worker, unsigned int* job);
+void* sweep_worker_main(void* arg);
+void write_result(FILE* out, sweep_config* config, sweep_job* job, sweep_result* result);
+
+int parse_number_list(char* spec, unsigned long** values, unsigned int* count){
+    unsigned int capacity = LIST_INITIAL_LENGTH;
+    *count = 0;
+    *values = malloc(capacity * sizeof(unsigned long));
+    if(*values == NULL)
+        return OUT_OF_MEM;
+
+    char* p = spec;
+    while(true){
+        char* end;
+        unsigned long low = strtoul(p, &end, 10);
+        if(end == p)
+            break;
+        unsigned long high = low;
+        if(*end == RANGE_SEPARATOR){
+            p = end + 1;
+            high = strtoul(p, &end, 10);
+            if(end == p || high < low)
+                break;
+        }
+
+        //Jobs are numbered with unsigned ints, so no list can be longer than that
+        if(high - low >= UINT_MAX - *count)
+            break;
+        for(unsigned long value = low; value <= high; ++value){
+            if(*count == capacity){
+                capacity = (capacity > UINT_MAX / 2) ? UINT_MAX : capacity * 2;
+                unsigned long* grown = realloc(*values, capacity * sizeof(unsigned long));
+                if(grown == NULL){
+                    free(*values);
+                    return OUT_OF_MEM;
+                }
+                *values = grown;
+            }
+            (*values)[(*count)++] = value;
+        }
+
+        if(*end == '\0')
+            return NO_ERR;
+        if(*end != LIST_SEPARATOR)
+            break;
+        p = end + 1;
+    }
+
+    free(*values);
+    return ARG_ERR;
+}
+
+int split_rule_list(char* spec, char*** rules, unsigned int* count){
+    char* copy = strdup(spec);
+    if(copy == NULL)
+        return OUT_OF_MEM;
+
+    *count = 1;
+    for(char* p = copy; *p != '\0'; ++p){
+        if(*p == LIST_SEPARATOR)
+            ++*count;
+    }
+    *rules = malloc(*count * sizeof(char*));
+    if(*rules == NULL){
+        free(copy);
+        return OUT_OF_MEM;
+    }
+
+    //The first entry points at the start of the copy, so freeing it frees every rule string
+    unsigned int index = 0;
+    (*rules)[index++] = copy;
+    for(char* p = copy; *p != '\0'; ++p){
+        if(*p == LIST_SEPARATOR){
+            *p = '\0';
+            (*rules)[index++] = p + 1;
+        }
+    }
+
+    rule_set parsed;
+    for(unsigned int i = 0; i < *count; ++i){
+        if(parse_rules(&parsed, (*rules)[i])){
+            free(copy);
+            free(*rules);
+            return RULE_PARSE_FAIL;
+        }
+    }
+    return NO_ERR;
+}
+
+//Hash collisions could only end a run early with a wrong period, which is acceptable for a survey
+uint64_t hash_field(field_data* field){
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    uint32_t* bitmap = field->buffer_r->bitmap;
+    for(uint64_t i = 0; i < field->buffer_r->num_words; ++i)
+        hash = (hash ^ bitmap[i]) * 0x100000001B3ULL;
+    return hash;
+}
+
+void run_job(sweep_state* state, sweep_job* job, sweep_result* result){
+    sweep_config* config = state->config;
+    field_data field;
+
+    result->stable_generation = -1;
+    result->period = 0;
+    result->curve_len = 0;
+    result->generations = 0;
+    result->status = init_field_seeded(&field, config->width, config->height, job->seed_rate, job->random_seed, config->edge_wrap, job->rule);
+    if(result->status)
+        return;
+
+    uint64_t history[SWEEP_MAX_PERIOD];
+    measure_field(&field, &result->start);
+    result->curve[result->curve_len++] = result->start.population;
+    history[0] = hash_field(&field);
+
+    for(unsigned int generation = 1; generation <= config->generations; ++generation){
+        update_and_swap_fields(&field);
+        result->generations = generation;
+
+        uint64_t hash = hash_field(&field);
+        unsigned int max_period = (generation < SWEEP_MAX_PERIOD) ? generation : SWEEP_MAX_PERIOD;
+        for(unsigned int period = 1; period <= max_period; ++period){
+            if(history[(generation - period) % SWEEP_MAX_PERIOD] == hash){
+                result->stable_generation = generation - period;
+                result->period = period;
+                break;
+            }
+        }
+        history[generation % SWEEP_MAX_PERIOD] = hash;
+
+        if(generation % state->curve_step == 0){
+            field_stats stats;
+            measure_field(&field, &stats);
+            result->curve[result->curve_len++] = stats.population;
+        }
+        //Nothing more can happen once the field repeats itself
+        if(result->period)
+            break;
+    }
+
+    measure_field(&field, &result->end);
+    free_field(&field);
+}
+
+bool take_job(sweep_state* state, unsigned int worker, unsigned int* job){
+    job_queue* own = &state->queues[worker];
+    pthread_mutex_lock(&own->lock);
+    bool found = (own->top < own->bottom);
+    if(found)
+        *job = --own->bottom;
+    pthread_mutex_unlock(&own->lock);
+    if(found)
+        return true;
+
+    for(unsigned int i = 1; i < state->num_queues; ++i){
+        job_queue* victim = &state->queues[(worker + i) % state->num_queues];
+        pthread_mutex_lock(&victim->lock);
+        found = (victim->top < victim->bottom);
+        if(found)
+            *job = victim->top++;
+        pthread_mutex_unlock(&victim->lock);
+        if(found)
+            return true;
+    }
+    return false;
+}
+
+void* sweep_worker_main(void* arg){
+    sweep_worker* worker = arg;
+    sweep_state* state = worker->state;
+    unsigned int job;
+    while(take_job(state, worker->index, &job)){
+        run_job(state, &state->jobs[job], &worker->result);
+        pthread_mutex_lock(&state->out_lock);
+        if(worker->result.status && state->status == NO_ERR)
+            state->status = worker->result.status;
+        write_result(state->config->out, state->config, &state->jobs[job], &worker->result);
+        fflush(state->config->out);
+        pthread_mutex_unlock(&state->out_lock);
+    }
+    return NULL;
+}
+
+void write_result(FILE* out, sweep_config* config, sweep_job* job, sweep_result* result){
+    field_stats* start = &result->start;
+    field_stats* end = &result->end;
+    fprintf(out, "%s,%u,%lu,%u,%u,%u,%" PRIu64 ",%i,%u,%u,%u,%u,%u,",
+            job->rule, job->seed_rate, job->random_seed, config->width, config->height,
+            result->generations, end->population, result->stable_generation, result->period,
+            start->population ? start->max_x - start->min_x + 1 : 0,
+            start->population ? start->max_y - start->min_y + 1 : 0,
+            end->population ? end->max_x - end->min_x + 1 : 0,
+            end->population ? end->max_y - end->min_y + 1 : 0);
+    for(unsigned int i = 0; i < result->curve_len; ++i)
+        fprintf(out, (i == 0) ? "%" PRIu64 : ";%" PRIu64, result->curve[i]);
+    fputc('\n', out);
+}
+
+int run_sweep(sweep_config* config){
+    char** rules;
+    unsigned int num_rules;
+    unsigned long* seed_rates;
+    unsigned int num_seed_rates;
+    unsigned long* random_seeds;
+    unsigned int num_random_seeds;
+
+    int status = split_rule_list(config->rules ? config->rules : DEFAULT_RULES, &rules, &num_rules);
+    if(status)
+        return status;
+    status = parse_number_list(config->seed_rates, &seed_rates, &num_seed_rates);
+    if(status){
+        free(rules[0]);
+        free(rules);
+        return status;
+    }
+    status = parse_number_list(config->random_seeds, &random_seeds, &num_random_seeds);
+    if(status){
+        free(rules[0]);
+        free(rules);
+        free(seed_rates);
+        return status;
+    }
+
+    //Every combination is a job, and there must not be more of them than an unsigned int can count
+    uint64_t num_combinations = (uint64_t) num_rules * num_seed_rates;
+    if(num_combinations > UINT_MAX || num_combinations * num_random_seeds > UINT_MAX){
+        free(rules[0]);
+        free(rules);
+        free(seed_rates);
+        free(random_seeds);
+        return ARG_ERR;
+    }
+    sweep_state state;
+    unsigned int num_jobs = num_combinations * num_random_seeds;
+    unsigned int threads = config->threads ? config->threads : sysconf(_SC_NPROCESSORS_ONLN);
+    if(threads > num_jobs)
+        threads = num_jobs;
+    state.config = config;
+    state.num_queues = threads;
+    state.curve_step = config->generations / SWEEP_CURVE_POINTS;
+    if(state.curve_step < 1)
+        state.curve_step = 1;
+    unsigned int curve_capacity = (config->generations / state.curve_step) + 1;
+
+    state.jobs = malloc((size_t) num_jobs * sizeof(sweep_job));
+    state.queues = malloc(threads * sizeof(job_queue));
+    uint64_t* curves = malloc((size_t) threads * curve_capacity * sizeof(uint64_t));
+    sweep_worker* workers = malloc(threads * sizeof(sweep_worker));
+    status = (state.jobs && state.queues && curves && workers) ? NO_ERR : OUT_OF_MEM;
+
+    if(status == NO_ERR){
+        unsigned int job = 0;
+        for(unsigned int r = 0; r < num_rules; ++r){
+            for(unsigned int s = 0; s < num_seed_rates; ++s){
+                for(unsigned int seed = 0; seed < num_random_seeds; ++seed, ++job){
+                    state.jobs[job].rule = rules[r];
+                    state.jobs[job].seed_rate = seed_rates[s];
+                    state.jobs[job].random_seed = random_seeds[seed];
+                }
+            }
+        }
+
+        fputs("rule,seed_rate,random_seed,width,height,generations,population,stable_generation,period,"
+              "start_bbox_width,start_bbox_height,end_bbox_width,end_bbox_height,population_curve\n", config->out);
+        state.status = NO_ERR;
+        pthread_mutex_init(&state.out_lock, NULL);
+        for(unsigned int i = 0; i < threads; ++i){
+            pthread_mutex_init(&state.queues[i].lock, NULL);
+            state.queues[i].top = ((uint64_t) i * num_jobs) / threads;
+            state.queues[i].bottom = ((uint64_t) (i + 1) * num_jobs) / threads;
+        }
+        //Workers steal from every queue, so the ones that started also run the jobs of any that
+        //could not be.  If none could, this thread runs them all
+        unsigned int started = 0;
+        for(unsigned int i = 0; i < threads; ++i){
+            workers[i].state = &state;
+            workers[i].index = i;
+            workers[i].result.curve = curves + ((size_t) i * curve_capacity);
+        }
+        while(started < threads && pthread_create(&workers[started].thread, NULL, sweep_worker_main, &workers[started]) == 0)
+            ++started;
+        if(started == 0)
+            sweep_worker_main(&workers[0]);
+        for(unsigned int i = 0; i < started; ++i)
+            pthread_join(workers[i].thread, NULL);
+        for(unsigned int i = 0; i < threads; ++i)
+            pthread_mutex_destroy(&state.queues[i].lock);
+        pthread_mutex_destroy(&state.out_lock);
+        status = state.status;
+    }
+
+    free(workers);
+    free(curves);
+    free(state.queues);
+    free(state.jobs);
+    free(random_seeds);
+    free(seed_rates);
+    free(rules[0]);
+    free(rules);
+    return status;
+}
@@ -0,0 +1,32 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+//Default dimensions and length of every run in a sweep
+#define SWEEP_SIZE 64
+#define SWEEP_GENERATIONS 1000
+//Longest oscillation period a run checks for before it counts as stabilized
+#define SWEEP_MAX_PERIOD 64
+//Number of population samples written for every run
+#define SWEEP_CURVE_POINTS 32
+
+typedef struct sweep_config_t{
+    //Comma separated rule strings, eg "23/3,5/23"
+    char* rules;
+    //Comma separated seed rates or ranges of them, eg "2,3,10-12".  A rate of 0 leaves the field empty
+    char* seed_rates;
+    //Comma separated random seeds or ranges of them, eg "1-1000"
+    char* random_seeds;
+    unsigned int width;
+    unsigned int height;
+    unsigned int generations;
+    unsigned int threads;
+    bool edge_wrap;
+    FILE* out;
+} sweep_config;
+
+int run_sweep(sweep_config* config);
+
+#endif
@@ -0,0 +1,116 @@
+#include "temporal_block.h"
+#include "kernels.h"
+#include "errcode.h"
+
+typedef struct band_scratch_t{
+    uint32_t* rows[2];
+    //Where every scratch row of the current and next generation lives.  Rows outside a field
+    //without edge wrapping are NULL, since they are dead forever and never computed
+    uint32_t** current;
+    uint32_t** next;
+} band_scratch;
+
+unsigned int band_height(field_data* field, unsigned int depth);
+void advance_band(field_data* field, band_scratch* scratch, row_kernel kernel, unsigned int first_row, unsigned int rows, unsigned int depth);
+int get_scratch(field_data* field, band_scratch* scratch, unsigned int capacity);
+bool band_row_odd(field_data* field, unsigned int first_row, unsigned int r, unsigned int depth);
+
+unsigned int band_height(field_data* field, unsigned int depth){
+    //Two copies of the band and its halos should stay in cache, but the band must not be
+    //so thin that recomputing the halos costs more than the memory traffic it saves
+    size_t row_bytes = field->row_words * sizeof(uint32_t);
+    size_t cache_rows = BLOCK_CACHE_BYTES / (2 * row_bytes);
+    unsigned int rows = (cache_rows > 4 * depth) ? cache_rows - 2 * depth : 2 * depth;
+    return (rows < field->size_y) ? rows : field->size_y;
+}
+
+void advance_band(field_data* field, band_scratch* scratch, row_kernel kernel, unsigned int first_row, unsigned int rows, unsigned int depth){
+    unsigned int scratch_rows = rows + 2 * depth;
+
+    //Scratch row r is field row first_row - depth + r.  The first generation reads the field directly
+    for(unsigned int r = 0; r < scratch_rows; ++r){
+        int y = (int) first_row - (int) depth + (int) r;
+        if(y < 0 || (unsigned int) y >= field->size_y){
+            if(!field->edge_wrap){
+                scratch->current[r] = NULL;
+                scratch->next[r] = NULL;
+                continue;
+            }
+            //Halos deeper than the field itself wrap around it more than once
+            y = ((y % (int) field->size_y) + (int) field->size_y) % (int) field->size_y;
+        }
+        scratch->current[r] = field_row(field, field->buffer_r, y);
+    }
+
+    //Each generation the rows that are still exact shrink by one on either side, until only
+    //the band is left.  The last generation is written straight into the field
+    for(unsigned int generation = 1; generation <= depth; ++generation){
+        uint32_t* next_rows = scratch->rows[generation % 2];
+        for(unsigned int r = generation; r < scratch_rows - generation; ++r){
+            if(scratch->current[r] == NULL)
+                continue;
+            uint32_t* out = (generation == depth) ? field_row(field, field->buffer_w, first_row + r - depth)
+                                                  : next_rows + (size_t) r * field->row_words;
+            step_row(kernel, &field->rules, scratch->current[r - 1], scratch->current[r], scratch->current[r + 1],
+                     out, 0, field->row_words, field->row_words, field->size_x, field->edge_wrap, band_row_odd(field, first_row, r, depth), NULL);
+            scratch->next[r] = out;
+        }
+        uint32_t** temp = scratch->current;
+        scratch->current = scratch->next;
+        scratch->next = temp;
+    }
+}
+
+//Parity of the field row that scratch row r stands for, wrapped the same way as the row itself
+bool band_row_odd(field_data* field, unsigned int first_row, unsigned int r, unsigned int depth){
+    int y = (int) first_row - (int) depth + (int) r;
+    y = ((y % (int) field->size_y) + (int) field->size_y) % (int) field->size_y;
+    return is_odd_row(field, y);
+}
+
+//Points scratch at room for capacity rows of both generations in the field's block scratch
+int get_scratch(field_data* field, band_scratch* scratch, unsigned int capacity){
+    size_t pointer_bytes = (size_t) capacity * sizeof(uint32_t*);
+    size_t row_bytes = (size_t) capacity * field->row_words * sizeof(uint32_t);
+    size_t size = 2 * pointer_bytes + 2 * row_bytes;
+    if(field->block_scratch_size < size){
+        free(field->block_scratch);
+        field->block_scratch = malloc(size);
+        field->block_scratch_size = field->block_scratch ? size : 0;
+        if(field->block_scratch == NULL)
+            return OUT_OF_MEM;
+    }
+
+    //The pointers go first, so the rows after them stay aligned
+    char* memory = field->block_scratch;
+    scratch->current = (uint32_t**) memory;
+    scratch->next = (uint32_t**) (memory + pointer_bytes);
+    scratch->rows[0] = (uint32_t*) (memory + 2 * pointer_bytes);
+    scratch->rows[1] = (uint32_t*) (memory + 2 * pointer_bytes + row_bytes);
+    return NO_ERR;
+}
+
+int update_fields_blocked(field_data* field, unsigned int generations, unsigned int depth){
+    if(depth < 1)
+        depth = 1;
+    if(depth > MAX_BLOCK_DEPTH)
+        depth = MAX_BLOCK_DEPTH;
+
+    unsigned int rows = band_height(field, depth);
+    unsigned int capacity = rows + 2 * depth;
+    band_scratch scratch;
+    if(get_scratch(field, &scratch, capacity) != NO_ERR)
+        return OUT_OF_MEM;
+
+    row_kernel kernel = find_rule_kernel(&field->rules);
+    while(generations > 0){
+        unsigned int block = (generations < depth) ? generations : depth;
+        for(unsigned int first_row = 0; first_row < field->size_y; first_row += rows){
+            unsigned int band_rows = (first_row + rows <= field->size_y) ? rows : field->size_y - first_row;
+            advance_band(field, &scratch, kernel, first_row, band_rows, block);
+        }
+        swap_buffers(field);
+        generations -= block;
+    }
+    return NO_ERR;
+}
@@ -0,0 +1,13 @@
+#ifndef TEMPORAL_BLOCK_H
+#define TEMPORAL_BLOCK_H
+
+#include "gamefield.h"
+
+//Working set a band of rows should fit in while it is advanced several generations
+#define BLOCK_CACHE_BYTES (256 * 1024)
+//Deepest temporal block allowed, in generations
+#define MAX_BLOCK_DEPTH 32
+
+int update_fields_blocked(field_data* field, unsigned int generations, unsigned int depth);
+
+#endif